@@ -19,13 +19,26 @@ find_library(Tiff_LIBRARY NAMES tiff
   /usr/lib
   /usr/local/lib)
 
-if(BUILD_STATIC)
-# -llept -lgif -lwebp -ltiff -lpng -ljpeg -lz
-find_library(Lept_LIBRARY NAMES lept
+# Leptonica (optional): lets the OCR reuse its Pix image buffers
+find_path(Lept_INCLUDE_DIR leptonica/allheaders.h
+  HINTS
+  /usr/include
+  /usr/local/include)
+
+find_library(Lept_LIBRARY NAMES lept leptonica
   HINTS
   /usr/lib
   /usr/local/lib)
 
+if(Lept_INCLUDE_DIR AND Lept_LIBRARY)
+  add_definitions("-DCONFIG_LEPTONICA")
+else()
+  message(STATUS "Leptonica not found: OCR images are passed to tesseract as raw data.")
+endif()
+
+if(BUILD_STATIC)
+# -llept -lgif -lwebp -ltiff -lpng -ljpeg -lz
+
 find_library(Webp_LIBRARY NAMES webp
   HINTS
   /usr/lib
@@ -59,6 +72,8 @@ list(REMOVE_ITEM CMAKE_REQUIRED_INCLUDES ${Tesseract_INCLUDE_DIR})
 
 if(BUILD_STATIC)
   set(Tesseract_LIBRARIES ${Tesseract_LIBRARIES} ${Lept_LIBRARY} ${PNG_LIBRARY} ${Tiff_LIBRARY} ${Webp_LIBRARY} ${GIF_LIBRARY} ${JPEG_LIBRARY} ${ZLIB_LIBRARY})
+elseif(Lept_INCLUDE_DIR AND Lept_LIBRARY)
+  set(Tesseract_LIBRARIES ${Tesseract_LIBRARIES} ${Lept_LIBRARY} ${Tiff_LIBRARY})
 else()
   set(Tesseract_LIBRARIES ${Tesseract_LIBRARIES} ${Tiff_LIBRARY})
 endif()
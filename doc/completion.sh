@@ -40,11 +40,39 @@ _vobsub2srt() {
             _filedir -d
             return 0
             ;;
+        --ocr-backend)
+            COMPREPLY=( $( compgen -W 'tesseract null' -- "$cur" ) )
+            return 0
+            ;;
+        --ocr-profile)
+            COMPREPLY=( $( compgen -W 'fast balanced accurate' -- "$cur" ) )
+            return 0
+            ;;
+        --dump-format)
+            COMPREPLY=( $( compgen -W 'pgm tar' -- "$cur" ) )
+            return 0
+            ;;
+        --format)
+            COMPREPLY=( $( compgen -W 'srt vtt ass jsonl' -- "$cur" ) )
+            return 0
+            ;;
+        --output|--stats-json)
+            _filedir
+            return 0
+            ;;
+        --timeout-fallback)
+            COMPREPLY=( $( compgen -W 'retry fail' -- "$cur" ) )
+            return 0
+            ;;
+        --benchmark-profiles)
+            _filedir '(srt|SRT)'
+            return 0
+            ;;
     esac
 
     case $cur in
         -*)
-            COMPREPLY=( $( compgen -W '--dump-images --verbose --ifo --lang --langlist --tesseract-lang --tesseract-data --blacklist --y-threshold --min-width --min-height' -- "$cur" ) )
+            COMPREPLY=( $( compgen -W '--dump-images --dump-format --verbose --format --output --output-fd --ifo --lang --langlist --tesseract-lang --tesseract-data --ocr-backend --ocr-profile --tess-var --benchmark-profiles --ocr-scale --binarize --ocr-timeout --timeout-fallback --blacklist --y-threshold --min-width --min-height --forced-only --tier-threshold --ocr-batch --no-line-split --no-dedup --glyph-cache --journal --resume --stats --stats-json --threads' -- "$cur" ) )
             ;;
         *)
             _filedir '(idx|IDX|sub|SUB)'
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <pthread.h>
 
 #if 0 // R: no iconv, charset stuff
 #include "config.h"
@@ -36,11 +37,17 @@
 /* maximum message length of mp_msg */
 #define MSGSIZE_MAX 3072
 
+/* R: the levels and flags are only written by the caller during
+ * initialization.  The output state (header/statusline) in mp_msg is guarded by
+ * msg_lock, so messages from several decoder threads do not interleave. */
+static pthread_mutex_t msg_lock = PTHREAD_MUTEX_INITIALIZER;
+
 int mp_msg_levels[MSGT_MAX]; // verbose level of this module. initialized to -2
 int mp_msg_level_all = MSGL_STATUS;
 int verbose = 0;
 int mp_msg_color = 0;
 int mp_msg_module = 0;
+int mp_msg_stderr = 0; // R: write all messages to stderr (when the subtitles go to stdout)
 #ifdef CONFIG_ICONV
 char *mp_msg_charset = NULL;
 static char *old_charset = NULL;
@@ -183,7 +190,7 @@ static void print_msg_module(FILE* stream, int mod)
 void mp_msg(int mod, int lev, const char *format, ... ){
     va_list va;
     char tmp[MSGSIZE_MAX];
-    FILE *stream = lev <= MSGL_WARN ? stderr : stdout;
+    FILE *stream = lev <= MSGL_WARN || mp_msg_stderr ? stderr : stdout;
     static int header = 1;
     // indicates if last line printed was a status line
     static int statusline;
@@ -227,6 +234,7 @@ void mp_msg(int mod, int lev, const char *format, ... ){
     }
 #endif
 
+    pthread_mutex_lock(&msg_lock);
     // as a status line normally is intended to be overwitten by next status line
     // output a '\n' to get a normal message on a separate line
     if (statusline && lev != MSGL_STATUS) fprintf(stream, "\n");
@@ -242,4 +250,5 @@ void mp_msg(int mod, int lev, const char *format, ... ){
     if (mp_msg_color)
         fprintf(stream, "\033[0m");
     fflush(stream);
+    pthread_mutex_unlock(&msg_lock);
 }
@@ -134,6 +134,7 @@ extern int verbose;
 extern char *mp_msg_charset;
 extern int mp_msg_color;
 extern int mp_msg_module;
+extern int mp_msg_stderr;
 
 extern int mp_msg_levels[MSGT_MAX];
 extern int mp_msg_level_all;
@@ -32,35 +32,24 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 //#include "libvo/sub.h"  // R: no OSD stuff needed
 //#include "libvo/video_out.h" // R: no OSD stuff needed
 
-int sub_pos = 100; // R: copied from libvo/sub.c
-
 #include "spudec.h"
+#include "spudec_simd.h" // R: vectorized pal2gray_alpha
 #include "vobsub.h"
 // #include "libswscale/swscale.h" // R: no swscalar gaussian aamode
 
 #define FFMAX(a,b) ((a) > (b) ? (a) : (b))
 #define FFMIN(a,b) ((a) > (b) ? (b) : (a))
 
-/* Valid values for spu_aamode:
-   0: none (fastest, most ugly)
-   1: approximate
-   2: full (slowest)
-   3: bilinear (similiar to vobsub, fast and not too bad)
-   4: uses swscaler gaussian (this is the only one that looks good) R: Not supported (libswscale dependency removed)
- */
-
-int spu_aamode = 3;
-int spu_alignment = -1;
-float spu_gaussvar = 1.0;
-
 typedef struct packet_t packet_t;
 struct packet_t {
   int is_decoded;
@@ -77,9 +66,35 @@ struct packet_t {
   unsigned int start_row;
   unsigned int width, height, stride;
   unsigned int start_pts, end_pts;
+  int pts100;			/* R: time stamp of the packet (for spudec_drain) */
+  int is_forced;		/* R: queued by a forced display command (0x00) */
+  unsigned int serial;		/* R: number of the assembled SPU packet */
   packet_t *next;
 };
 
+/* R: Size-classed buffer pool for image planes and packet copies.  Each
+   buffer starts with a header recording its class, so it can be returned
+   without knowing its size.  Classes are powers of two from 4 KiB to 4 MiB;
+   larger buffers bypass the pool. */
+#define POOL_MIN_SHIFT 12
+#define POOL_CLASSES   11
+#define POOL_DEPTH     4
+#define POOL_MAX_CACHED (16 * 1024 * 1024)
+
+typedef union {
+  struct {
+    int size_class;           /* -1 if not pooled */
+    size_t capacity;          /* usable bytes after the header */
+  } h;
+  long double align;
+} pool_header_t;
+
+struct buffer_pool {
+  void *free_list[POOL_CLASSES][POOL_DEPTH];
+  int free_count[POOL_CLASSES];
+  spudec_pool_stats_t stats;
+};
+
 struct palette_crop_cache {
   int valid;
   uint32_t palette;
@@ -107,11 +122,14 @@ typedef struct {
   unsigned int start_row;
   unsigned int width, height, stride;
   size_t image_size;		/* Size of the image buffer */
-  unsigned char *image;		/* Grayscale value */
-  unsigned char *aimage;	/* Alpha value */
+  unsigned char *image_buf;	/* R: allocation holding both image planes */
+  size_t image_capacity;	/* R: usable size of image_buf */
+  unsigned char *image;		/* Grayscale value (R: view into image_buf) */
+  unsigned char *aimage;	/* Alpha value (R: view into image_buf) */
   unsigned int pal_start_col, pal_start_row;
   unsigned int pal_width, pal_height;
   unsigned char *pal_image;	/* palette entry value */
+  size_t pal_capacity;		/* R: usable size of pal_image */
   unsigned int scaled_frame_width, scaled_frame_height;
   unsigned int scaled_start_col, scaled_start_row;
   unsigned int scaled_width, scaled_height, scaled_stride;
@@ -126,8 +144,97 @@ typedef struct {
   unsigned int is_forced_sub;         /* true if current subtitle is a forced subtitle */
 
   struct palette_crop_cache palette_crop_cache;
+
+  /* R: the following used to be the globals spu_aamode, spu_alignment,
+     spu_gaussvar and sub_pos (libvo/sub.c). */
+  /* Valid values for aamode:
+     0: none (fastest, most ugly)
+     1: approximate
+     2: full (slowest)
+     3: bilinear (similiar to vobsub, fast and not too bad)
+     4: uses swscaler gaussian (this is the only one that looks good) R: Not supported (libswscale dependency removed)
+   */
+  int aamode;
+  int alignment;
+  float gaussvar;
+  int sub_pos;
+
+  struct buffer_pool pool;	/* R: owns image, pal_image and packet buffers */
+  int threads;			/* R: decoder threads for spudec_drain, 0: auto */
+  unsigned int serial;		/* R: number of assembled SPU packets */
+  spudec_decode_stats_t stats;	/* R: see spudec_get_decode_stats */
 } spudec_handle_t;
 
+/* R: monotonic clock for spudec_decode_stats_t */
+static uint64_t spudec_clock_ns(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static pool_header_t *pool_header(void *p)
+{
+  return (pool_header_t *)p - 1;
+}
+
+static size_t pool_capacity(void *p)
+{
+  return p ? pool_header(p)->h.capacity : 0;
+}
+
+static void *pool_alloc(struct buffer_pool *pool, size_t size)
+{
+  pool_header_t *hdr;
+  int c = 0;
+  while (c < POOL_CLASSES && ((size_t)1 << (c + POOL_MIN_SHIFT)) - sizeof(pool_header_t) < size)
+    ++c;
+  ++pool->stats.requests;
+  if (c < POOL_CLASSES && pool->free_count[c] > 0) {
+    void *p = pool->free_list[c][--pool->free_count[c]];
+    ++pool->stats.reused;
+    pool->stats.cached_bytes -= pool_capacity(p);
+    return p;
+  }
+  if (c < POOL_CLASSES)
+    size = ((size_t)1 << (c + POOL_MIN_SHIFT)) - sizeof(pool_header_t);
+  else
+    c = -1;
+  hdr = malloc(sizeof(pool_header_t) + size);
+  if (!hdr)
+    return NULL;
+  ++pool->stats.allocated;
+  hdr->h.size_class = c;
+  hdr->h.capacity = size;
+  return hdr + 1;
+}
+
+static void pool_free(struct buffer_pool *pool, void *p)
+{
+  int c;
+  if (!p)
+    return;
+  c = pool_header(p)->h.size_class;
+  ++pool->stats.released;
+  if (c >= 0 && pool->free_count[c] < POOL_DEPTH &&
+      pool->stats.cached_bytes + pool_capacity(p) <= POOL_MAX_CACHED) {
+    pool->free_list[c][pool->free_count[c]++] = p;
+    pool->stats.cached_bytes += pool_capacity(p);
+    return;
+  }
+  ++pool->stats.dropped;
+  free(pool_header(p));
+}
+
+static void pool_clear(struct buffer_pool *pool)
+{
+  int c;
+  for (c = 0; c < POOL_CLASSES; ++c)
+    while (pool->free_count[c] > 0)
+      free(pool_header(pool->free_list[c][--pool->free_count[c]]));
+  pool->stats.cached_bytes = 0;
+}
+
 static void spudec_queue_packet(spudec_handle_t *this, packet_t *packet)
 {
   if (this->queue_head == NULL)
@@ -148,9 +255,9 @@ static packet_t *spudec_dequeue_packet(spudec_handle_t *this)
   return retval;
 }
 
-static void spudec_free_packet(packet_t *packet)
+static void spudec_free_packet(spudec_handle_t *this, packet_t *packet)
 {
-  free(packet->packet);
+  pool_free(&this->pool, packet->packet);
   free(packet);
 }
 
@@ -189,36 +296,30 @@ static inline unsigned char get_nibble(packet_t *packet)
 }
 
 /* Cut the sub to visible part */
+// R: Trims all four sides with a vectorized scan.  Instead of moving the data
+// image/aimage are turned into a view on the bounding box (stride is kept).
 static inline void spudec_cut_image(spudec_handle_t *this)
 {
-  unsigned int fy, ly;
-  unsigned int first_y, last_y;
+  int x0, y0, x1, y1;
+  size_t offset;
 
-  if (this->stride == 0 || this->height == 0) {
+  if (this->stride == 0 || this->height == 0 || this->width == 0) {
     return;
   }
 
-  for (fy = 0; fy < this->image_size && !this->aimage[fy]; fy++);
-  for (ly = this->stride * this->height-1; ly && !this->aimage[ly]; ly--);
-  first_y = fy / this->stride;
-  last_y = ly / this->stride;
-  //printf("first_y: %d, last_y: %d\n", first_y, last_y);
-  this->start_row += first_y;
-
-  // Some subtitles trigger this condition
-  if (last_y + 1 > first_y ) {
-	  this->height = last_y - first_y +1;
-  } else {
-	  this->height = 0;
-	  return;
+  if (!spudec_find_bbox(this->aimage, this->stride, this->width, this->height,
+                        &x0, &y0, &x1, &y1)) {
+    this->height = 0;
+    return;
   }
 
-//  printf("new h %d new start %d (sz %d st %d)---\n\n", this->height, this->start_row, this->image_size, this->stride);
-
-  if (first_y > 0) {
-    memmove(this->image,  this->image  + this->stride * first_y, this->stride * this->height);
-    memmove(this->aimage, this->aimage + this->stride * first_y, this->stride * this->height);
-  }
+  offset = (size_t)y0 * this->stride + x0;
+  this->image  += offset;
+  this->aimage += offset;
+  this->start_col += x0;
+  this->start_row += y0;
+  this->width  = x1 - x0 + 1;
+  this->height = y1 - y0 + 1;
 }
 
 
@@ -228,44 +329,49 @@ static int spudec_alloc_image(spudec_handle_t *this, int stride, int height)
     this->width = stride;
   this->stride = stride;
   this->height = height;
-  if (this->image_size < this->stride * this->height) {
-    if (this->image != NULL) {
-      free(this->image);
-      free(this->pal_image);
-      this->image_size = 0;
-      this->pal_width = this->pal_height  = 0;
-    }
-    this->image = malloc(2 * this->stride * this->height);
-    if (this->image) {
-      this->image_size = this->stride * this->height;
-      this->aimage = this->image + this->image_size;
-      // use stride here as well to simplify reallocation checks
-      this->pal_image = malloc(this->stride * this->height);
-    }
+  // R: image_size is the size of one plane of the current image, the
+  // buffers come from the pool and are only replaced if they are too small.
+  this->image_size = this->stride * this->height;
+  if (this->image_capacity < 2 * this->image_size) {
+    pool_free(&this->pool, this->image_buf);
+    this->image_buf = pool_alloc(&this->pool, 2 * this->image_size);
+    this->image_capacity = pool_capacity(this->image_buf);
+  }
+  // use stride here as well to simplify reallocation checks
+  if (this->pal_capacity < this->image_size) {
+    pool_free(&this->pool, this->pal_image);
+    this->pal_image = pool_alloc(&this->pool, this->image_size);
+    this->pal_capacity = pool_capacity(this->pal_image);
+  }
+  if (!this->image_buf || !this->pal_image) {
+    this->image_size = this->image_capacity = this->pal_capacity = 0;
+    this->pal_width = this->pal_height = 0;
   }
-  return this->image != NULL;
+  this->image  = this->image_buf;
+  this->aimage = this->image_buf + this->image_size;
+  return this->image_buf != NULL && this->pal_image != NULL;
 }
 
-/**
- * \param pal palette in MPlayer-style gray-alpha values, i.e.
- *            alpha == 0 means transparent, 1 fully opaque,
- *            gray value <= 256 - alpha.
- */
-static void pal2gray_alpha(const uint16_t *pal,
-                           const uint8_t *src, int src_stride,
-                           uint8_t *dst, uint8_t *dsta,
-                           int dst_stride, int w, int h)
+/* R: convert palette/alpha indices into an MPlayer-style gray/alpha palette
+   (split out of apply_palette_crop) */
+static void gray_alpha_palette(const spudec_handle_t *this,
+                               const unsigned int *palette,
+                               const unsigned int *alpha4, uint16_t *pal)
 {
-  int x, y;
-  for (y = 0; y < h; y++) {
-    for (x = 0; x < w; x++) {
-      uint16_t pixel = pal[src[x]];
-      *dst++  = pixel;
-      *dsta++ = pixel >> 8;
-    }
-    for (; x < dst_stride; x++)
-      *dsta++ = *dst++ = 0;
-    src += src_stride;
+  int i;
+  for (i = 0; i < 4; ++i) {
+    int color;
+    int alpha = alpha4[i];
+    // extend 4 -> 8 bit
+    alpha |= alpha << 4;
+    if (this->custom && (this->cuspal[i] >> 31) != 0)
+      alpha = 0;
+    color = this->custom ? this->cuspal[i] :
+            this->global_palette[palette[i]];
+    color = (color >> 16) & 0xff;
+    // convert to MPlayer-style gray/alpha palette
+    color = FFMIN(color, alpha);
+    pal[i] = (-alpha << 8) | color;
   }
 }
 
@@ -273,32 +379,23 @@ static int apply_palette_crop(spudec_handle_t *this,
                               unsigned crop_x, unsigned crop_y,
                               unsigned crop_w, unsigned crop_h)
 {
-  int i;
   uint8_t *src;
   uint16_t pal[4];
   unsigned stride = (crop_w + 7) & ~7;
+  // R: the crop_h check used pal_width, rejecting images taller than wide
   if (crop_x > this->pal_width || crop_y > this->pal_height ||
-      crop_w > this->pal_width - crop_x || crop_h > this->pal_width - crop_y ||
+      crop_w > this->pal_width - crop_x || crop_h > this->pal_height - crop_y ||
       crop_w > 0x8000 || crop_h > 0x8000 ||
       stride * crop_h  > this->image_size) {
     return 0;
   }
-  for (i = 0; i < 4; ++i) {
-    int color;
-    int alpha = this->alpha[i];
-    // extend 4 -> 8 bit
-    alpha |= alpha << 4;
-    if (this->custom && (this->cuspal[i] >> 31) != 0)
-      alpha = 0;
-    color = this->custom ? this->cuspal[i] :
-            this->global_palette[this->palette[i]];
-    color = (color >> 16) & 0xff;
-    // convert to MPlayer-style gray/alpha palette
-    color = FFMIN(color, alpha);
-    pal[i] = (-alpha << 8) | color;
-  }
+  gray_alpha_palette(this, this->palette, this->alpha, pal);
   src = this->pal_image + crop_y * this->pal_width + crop_x;
-  pal2gray_alpha(pal, src, this->pal_width,
+  // R: reset the view left by the last spudec_cut_image
+  this->image  = this->image_buf;
+  this->aimage = this->image_buf + this->image_size;
+  // R: the RLE decoder only produces indices 0-3, use the SIMD version
+  pal2gray_alpha4(pal, src, this->pal_width,
                  this->image, this->aimage, stride,
                  crop_w, crop_h);
   this->width  = crop_w;
@@ -342,29 +439,21 @@ int spudec_apply_palette_crop(void *this, uint32_t palette,
   return c->result;
 }
 
-static void spudec_process_data(spudec_handle_t *this, packet_t *packet)
+/* R: RLE decode a packet into a width x height buffer of palette indices.
+   Only touches the packet, so different packets can be decoded in parallel.
+   Lines missing from the packet are left as index 0. */
+static void spudec_rle_decode(packet_t *packet, uint8_t *dst,
+                              unsigned int width, unsigned int height)
 {
   unsigned int i, x, y;
-  uint8_t *dst;
-
-  if (!spudec_alloc_image(this, packet->stride, packet->height))
-    return;
-
-  this->pal_start_col = packet->start_col;
-  this->pal_start_row = packet->start_row;
-  this->pal_height = packet->height;
-  this->pal_width  = packet->width;
-  this->stride = packet->stride;
-  memcpy(this->palette, packet->palette, sizeof(this->palette));
-  memcpy(this->alpha,   packet->alpha,   sizeof(this->alpha));
+  uint8_t *const end = dst + width * height;
 
   i = packet->current_nibble[1];
   x = 0;
   y = 0;
-  dst = this->pal_image;
   while (packet->current_nibble[0] < i
 	 && packet->current_nibble[1] / 2 < packet->control_start
-	 && y < this->pal_height) {
+	 && y < height) {
     unsigned int len, color;
     unsigned int rle = 0;
     rle = get_nibble(packet);
@@ -379,8 +468,8 @@ static void spudec_process_data(spudec_handle_t *this, packet_t *packet)
     color = 3 - (rle & 0x3);
     len = rle >> 2;
     x += len;
-    if (len == 0 || x >= this->pal_width) {
-      len += this->pal_width - x;
+    if (len == 0 || x >= width) {
+      len += width - x;
       next_line(packet);
       x = 0;
       ++y;
@@ -388,7 +477,30 @@ static void spudec_process_data(spudec_handle_t *this, packet_t *packet)
     memset(dst, color, len);
     dst += len;
   }
+  if (dst < end)
+    memset(dst, 0, end - dst);
+}
+
+static void spudec_process_data(spudec_handle_t *this, packet_t *packet)
+{
+  uint64_t start;
+  if (!spudec_alloc_image(this, packet->stride, packet->height))
+    return;
+  start = spudec_clock_ns();
+
+  this->pal_start_col = packet->start_col;
+  this->pal_start_row = packet->start_row;
+  this->pal_height = packet->height;
+  this->pal_width  = packet->width;
+  this->stride = packet->stride;
+  memcpy(this->palette, packet->palette, sizeof(this->palette));
+  memcpy(this->alpha,   packet->alpha,   sizeof(this->alpha));
+
+  spudec_rle_decode(packet, this->pal_image, this->pal_width, this->pal_height);
   apply_palette_crop(this, 0, 0, this->pal_width, this->pal_height);
+  ++this->stats.images;
+  this->stats.pixels += (uint64_t)packet->width * packet->height;
+  this->stats.process_ns += spudec_clock_ns() - start;
 }
 
 
@@ -448,6 +560,7 @@ static void spudec_process_control(spudec_handle_t *this, int pts100)
   unsigned int height = 0;
   unsigned int stride = 0;
 
+  ++this->serial;
   control_start = get_be16(this->packet + 2);
   next_off = control_start;
   while (start_off != next_off) {
@@ -555,6 +668,12 @@ static void spudec_process_control(spudec_handle_t *this, int pts100)
       end_pts = get_be16(this->packet + next_off) * 1024;
       end_pts = 1 - pts100 >= end_pts ? 0 : pts100 + end_pts - 1;
     }
+    // R: with forced_subs_only, drop non-forced subtitles before their
+    // RLE data is copied and decoded
+    if (end_pts > 0 && this->forced_subs_only && !this->is_forced_sub) {
+      mp_msg(MSGT_SPUDEC,MSGL_DBG2,"Skipping non-forced subtitle at %u\n", start_pts);
+      continue;
+    }
     if (end_pts > 0) {
       packet_t *packet = calloc(1, sizeof(packet_t));
       int i;
@@ -568,11 +687,14 @@ static void spudec_process_control(spudec_handle_t *this, int pts100)
       packet->height = height;
       packet->stride = stride;
       packet->control_start = control_start;
+      packet->pts100 = pts100;
+      packet->is_forced = this->is_forced_sub != 0;
+      packet->serial = this->serial;
       for (i=0; i<4; i++) {
 	packet->alpha[i] = this->alpha[i];
 	packet->palette[i] = this->palette[i];
       }
-      packet->packet = malloc(this->packet_size);
+      packet->packet = pool_alloc(&this->pool, this->packet_size);
       memcpy(packet->packet, this->packet, this->packet_size);
       spudec_queue_packet(this, packet);
     }
@@ -603,12 +725,12 @@ int spudec_changed(void * this)
     return spu->spu_changed || spu->now_pts > spu->end_pts;
 }
 
-void spudec_assemble(void *this, unsigned char *packet, unsigned int len, int pts100)
+static void spudec_assemble_fragment(spudec_handle_t *spu, unsigned char *packet, unsigned int len, int pts100)
 {
-  spudec_handle_t *spu = this;
 //  spudec_heartbeat(this, pts100);
   if (len < 2) {
       mp_msg(MSGT_SPUDEC,MSGL_WARN,"SPUasm: packet too short\n");
+      ++spu->stats.broken;
       return;
   }
   spu->packet_pts = pts100;
@@ -624,6 +746,7 @@ void spudec_assemble(void *this, unsigned char *packet, unsigned int len, int pt
       spu->packet_size = len2;
       if (len > len2) {
 	mp_msg(MSGT_SPUDEC,MSGL_WARN,"SPUasm: invalid frag len / len2: %d / %d \n", len, len2);
+	++spu->stats.broken;
 	return;
       }
       memcpy(spu->packet, packet, len);
@@ -634,6 +757,7 @@ void spudec_assemble(void *this, unsigned char *packet, unsigned int len, int pt
     // Continue current fragment
     if (spu->packet_size < spu->packet_offset + len){
       mp_msg(MSGT_SPUDEC,MSGL_WARN,"SPUasm: invalid fragment\n");
+      ++spu->stats.broken;
       spu->packet_size = spu->packet_offset = 0;
       return;
     } else {
@@ -655,11 +779,13 @@ void spudec_assemble(void *this, unsigned char *packet, unsigned int len, int pt
         // we got it!
 	mp_msg(MSGT_SPUDEC,MSGL_DBG2,"SPUgot: off=%d  size=%d \n",spu->packet_offset,spu->packet_size);
 	spudec_decode(spu, pts100);
+	++spu->stats.packets;
 	spu->packet_offset = 0;
 	break;
       }
       if(y<=x || y>=spu->packet_size){ // invalid?
 	mp_msg(MSGT_SPUDEC,MSGL_WARN,"SPUtest: broken packet!!!!! y=%d < x=%d\n",y,x);
+        ++spu->stats.broken;
         spu->packet_size = spu->packet_offset = 0;
         break;
       }
@@ -676,29 +802,37 @@ void spudec_assemble(void *this, unsigned char *packet, unsigned int len, int pt
 #endif
 }
 
+/* R: spudec_assemble with statistics */
+void spudec_assemble(void *this, unsigned char *packet, unsigned int len, int pts100)
+{
+  spudec_handle_t *spu = this;
+  uint64_t start = spudec_clock_ns();
+  spudec_assemble_fragment(spu, packet, len, pts100);
+  ++spu->stats.fragments;
+  spu->stats.fragment_bytes += len;
+  spu->stats.assemble_ns += spudec_clock_ns() - start;
+}
+
 void spudec_reset(void *this)	// called after seek
 {
   spudec_handle_t *spu = this;
   while (spu->queue_head)
-    spudec_free_packet(spudec_dequeue_packet(spu));
+    spudec_free_packet(spu, spudec_dequeue_packet(spu));
   spu->now_pts = 0;
   spu->end_pts = 0;
   spu->packet_size = spu->packet_offset = 0;
 }
 
-void spudec_heartbeat(void *this, unsigned int pts100)
+static void spudec_show_packet(spudec_handle_t *spu, packet_t *packet)
 {
-  spudec_handle_t *spu = this;
-  spu->now_pts = pts100;
-
-  // TODO: detect and handle broken timestamps (e.g. due to wrapping)
-  while (spu->queue_head != NULL && pts100 >= spu->queue_head->start_pts) {
-    packet_t *packet = spudec_dequeue_packet(spu);
     spu->start_pts = packet->start_pts;
     spu->end_pts = packet->end_pts;
     if (packet->is_decoded) {
-      free(spu->image);
-      spu->image_size = packet->data_len;
+      pool_free(&spu->pool, spu->image_buf);
+      // R: image_size is the size of a single plane (was data_len)
+      spu->image_size = packet->stride * packet->height;
+      spu->image_buf  = packet->packet;
+      spu->image_capacity = pool_capacity(packet->packet);
       spu->image      = packet->packet;
       spu->aimage     = packet->packet + packet->stride * packet->height;
       packet->packet  = NULL;
@@ -716,9 +850,285 @@ void spudec_heartbeat(void *this, unsigned int pts100)
         compute_palette(spu, packet);
       spudec_process_data(spu, packet);
     }
-    spudec_free_packet(packet);
+    spudec_free_packet(spu, packet);
     spu->spu_changed = 1;
+}
+
+void spudec_heartbeat(void *this, unsigned int pts100)
+{
+  spudec_handle_t *spu = this;
+  spu->now_pts = pts100;
+
+  // TODO: detect and handle broken timestamps (e.g. due to wrapping)
+  while (spu->queue_head != NULL && pts100 >= spu->queue_head->start_pts)
+    spudec_show_packet(spu, spudec_dequeue_packet(spu));
+}
+
+/* R: allocate sub->image for sub->width x sub->height and copy src into it */
+static int spudec_copy_plane(spudec_subtitle_t *sub, const unsigned char *src,
+                             unsigned int src_stride)
+{
+  unsigned int y;
+  sub->stride = (sub->width + 7) & ~7;
+  sub->image  = NULL;
+  if (sub->width == 0 || sub->height == 0)
+    return 1;
+  sub->image = malloc(sub->stride * sub->height);
+  if (!sub->image)
+    return 0;
+  for (y = 0; y < sub->height; ++y) {
+    memcpy(sub->image + y * sub->stride, src + y * src_stride, sub->width);
+    memset(sub->image + y * sub->stride + sub->width, 0, sub->stride - sub->width);
+  }
+  return 1;
+}
+
+/* R: copy the gray plane of the current (cropped) image into sub */
+static int spudec_copy_subtitle(spudec_handle_t *spu, spudec_subtitle_t *sub)
+{
+  sub->x = spu->start_col;
+  sub->y = spu->start_row;
+  sub->width  = spu->width;
+  sub->height = spu->image ? spu->height : 0;
+  return spudec_copy_plane(sub, spu->image, spu->stride);
+}
+
+/* R: Parallel decoding for spudec_drain.  Control sequences are parsed and
+   palettes resolved sequentially (compute_palette and the palette/alpha
+   commands carry state from packet to packet).  What is left is packet
+   local: RLE decoding, palette mapping and cropping.  It runs on a few
+   threads which take jobs in order and keep their own scratch buffers. */
+struct decode_job {
+  packet_t *packet;
+  uint16_t pal[4];		/* resolved gray/alpha palette */
+  spudec_subtitle_t *sub;
+};
+
+struct decode_scratch {
+  uint8_t *pal_image;
+  size_t pal_size;
+  uint8_t *planes;
+  size_t planes_size;
+};
+
+struct decode_batch {
+  struct decode_job *jobs;
+  size_t count;
+  size_t next;			/* next job to take, guarded by lock */
+  int failed;
+  unsigned long images;		/* decoded images, guarded by lock */
+  uint64_t pixels, process_ns;	/* guarded by lock */
+  pthread_mutex_t lock;
+};
+
+static int scratch_reserve(uint8_t **buf, size_t *size, size_t needed)
+{
+  if (*size < needed) {
+    free(*buf);
+    *buf = malloc(needed);
+    *size = *buf ? needed : 0;
+  }
+  return *buf != NULL;
+}
+
+/* Same result as spudec_process_data followed by spudec_copy_subtitle, but
+   without touching the handle. */
+static int spudec_decode_job(struct decode_job *job, struct decode_scratch *s)
+{
+  packet_t *packet = job->packet;
+  spudec_subtitle_t *sub = job->sub;
+  unsigned int w = packet->width, h = packet->height, stride = packet->stride;
+  size_t plane = (size_t)stride * h;
+  int x0, y0, x1, y1;
+
+  sub->x = packet->start_col;
+  sub->y = packet->start_row;
+  sub->width  = w;
+  sub->height = h;
+  if (w == 0 || h == 0 || w > 0x8000 || h > 0x8000) {
+    sub->width = sub->height = 0;	/* empty, nothing to copy */
+    return spudec_copy_plane(sub, NULL, 0);
+  }
+  if (!scratch_reserve(&s->pal_image, &s->pal_size, (size_t)w * h) ||
+      !scratch_reserve(&s->planes, &s->planes_size, 2 * plane))
+    return 0;
+  spudec_rle_decode(packet, s->pal_image, w, h);
+  pal2gray_alpha4(job->pal, s->pal_image, w, s->planes, s->planes + plane,
+                  stride, w, h);
+  if (!spudec_find_bbox(s->planes + plane, stride, w, h, &x0, &y0, &x1, &y1)) {
+    sub->height = 0;
+    return spudec_copy_plane(sub, NULL, 0);
+  }
+  sub->x += x0;
+  sub->y += y0;
+  sub->width  = x1 - x0 + 1;
+  sub->height = y1 - y0 + 1;
+  return spudec_copy_plane(sub, s->planes + (size_t)y0 * stride + x0, stride);
+}
+
+static void *spudec_decode_worker(void *arg)
+{
+  struct decode_batch *batch = arg;
+  struct decode_scratch scratch;
+  unsigned long images = 0;
+  uint64_t pixels = 0, process_ns = 0;
+  memset(&scratch, 0, sizeof(scratch));
+  for (;;) {
+    struct decode_job *job = NULL;
+    uint64_t start;
+    pthread_mutex_lock(&batch->lock);
+    if (batch->next < batch->count && !batch->failed)
+      job = batch->jobs + batch->next++;
+    pthread_mutex_unlock(&batch->lock);
+    if (!job)
+      break;
+    start = spudec_clock_ns();
+    if (!spudec_decode_job(job, &scratch)) {
+      pthread_mutex_lock(&batch->lock);
+      batch->failed = 1;
+      pthread_mutex_unlock(&batch->lock);
+    }
+    process_ns += spudec_clock_ns() - start;
+    ++images;
+    pixels += (uint64_t)job->packet->width * job->packet->height;
+  }
+  pthread_mutex_lock(&batch->lock);
+  batch->images += images;
+  batch->pixels += pixels;
+  batch->process_ns += process_ns;
+  pthread_mutex_unlock(&batch->lock);
+  free(scratch.pal_image);
+  free(scratch.planes);
+  return NULL;
+}
+
+static int spudec_decode_threads(const spudec_handle_t *spu, size_t jobs)
+{
+  long n = spu->threads;
+  if (n <= 0) {
+#ifdef _SC_NPROCESSORS_ONLN
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n <= 0)
+      n = 1;
   }
+  if ((size_t)n > jobs)
+    n = jobs;
+  return n > 64 ? 64 : n;
+}
+
+static int spudec_decode_batch(spudec_handle_t *spu, struct decode_batch *batch)
+{
+  pthread_t threads[64];
+  int n = spudec_decode_threads(spu, batch->count);
+  int started = 0;
+
+  pthread_mutex_init(&batch->lock, NULL);
+  while (started + 1 < n &&
+         pthread_create(&threads[started], NULL, spudec_decode_worker, batch) == 0)
+    ++started;
+  spudec_decode_worker(batch); // the calling thread helps as well
+  while (started > 0)
+    pthread_join(threads[--started], NULL);
+  pthread_mutex_destroy(&batch->lock);
+  return batch->failed ? -1 : 0;
+}
+
+int spudec_drain(void *this, spudec_subtitle_t **subs, size_t *count, size_t *capacity)
+{
+  spudec_handle_t *spu = this;
+  struct decode_batch batch;
+  size_t queued = 0, i;
+  packet_t *p;
+  int ret = 0;
+  uint64_t start = spudec_clock_ns();
+
+  for (p = spu->queue_head; p != NULL; p = p->next)
+    ++queued;
+  if (queued == 0)
+    return 0;
+  if (*capacity < *count + queued) {
+    size_t n = *capacity ? *capacity : 64;
+    spudec_subtitle_t *tmp;
+    while (n < *count + queued)
+      n *= 2;
+    tmp = realloc(*subs, n * sizeof(spudec_subtitle_t));
+    if (tmp == NULL) {
+      mp_msg(MSGT_SPUDEC, MSGL_FATAL, "realloc failure");
+      return -1;
+    }
+    *subs = tmp;
+    *capacity = n;
+  }
+  memset(&batch, 0, sizeof(batch));
+  batch.jobs = malloc(queued * sizeof(struct decode_job));
+  if (batch.jobs == NULL) {
+    mp_msg(MSGT_SPUDEC, MSGL_FATAL, "malloc failure");
+    return -1;
+  }
+
+  // sequential part: drop superseded commands, resolve the palettes
+  while (spu->queue_head != NULL) {
+    packet_t *packet = spudec_dequeue_packet(spu);
+    spudec_subtitle_t *sub;
+    // A later display command of the same SPU packet with the same start
+    // time replaces this one (spudec_heartbeat would decode both and show
+    // the last).
+    if (spu->queue_head != NULL && spu->queue_head->serial == packet->serial &&
+        spu->queue_head->start_pts == packet->start_pts) {
+      spudec_free_packet(spu, packet);
+      continue;
+    }
+    sub = *subs + (*count)++;
+    sub->start_pts  = packet->start_pts;
+    sub->end_pts    = packet->end_pts;
+    sub->packet_pts = packet->pts100;
+    sub->forced     = packet->is_forced;
+    sub->image      = NULL;
+    sub->width = sub->height = 0;
+    spu->start_pts = packet->start_pts;
+    spu->end_pts   = packet->end_pts;
+    if (packet->is_decoded) {
+      spudec_show_packet(spu, packet);
+      if (!spudec_copy_subtitle(spu, sub))
+        ret = -1;
+      continue;
+    }
+    if (spu->auto_palette)
+      compute_palette(spu, packet);
+    batch.jobs[batch.count].packet = packet;
+    batch.jobs[batch.count].sub = sub;
+    gray_alpha_palette(spu, packet->palette, packet->alpha, batch.jobs[batch.count].pal);
+    ++batch.count;
+  }
+
+  // parallel part: RLE decoding, palette mapping, cropping
+  if (batch.count > 0 && spudec_decode_batch(spu, &batch) < 0)
+    ret = -1;
+  spu->stats.images += batch.images;
+  spu->stats.pixels += batch.pixels;
+  spu->stats.process_ns += batch.process_ns;
+  for (i = 0; i < batch.count; ++i)
+    spudec_free_packet(spu, batch.jobs[i].packet);
+  free(batch.jobs);
+  if (ret < 0)
+    mp_msg(MSGT_SPUDEC, MSGL_FATAL, "malloc failure");
+  spu->spu_changed = 1;
+  spu->stats.drain_ns += spudec_clock_ns() - start;
+  return ret;
+}
+
+void spudec_set_threads(void *this, int threads)
+{
+  ((spudec_handle_t *)this)->threads = threads;
+}
+
+void spudec_free_subtitles(spudec_subtitle_t *subs, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; ++i)
+    free(subs[i].image);
+  free(subs);
 }
 
 int spudec_visible(void *this){
@@ -767,24 +1177,24 @@ void spudec_calc_bbox(void *me, unsigned int dxs, unsigned int dys, unsigned int
     unsigned int scaley = 0x100 * dys / spu->orig_frame_height;
     bbox[0] = spu->start_col * scalex / 0x100;
     bbox[1] = spu->start_col * scalex / 0x100 + spu->width * scalex / 0x100;
-    switch (spu_alignment) {
+    switch (spu->alignment) {
     case 0:
-      bbox[3] = dys*sub_pos/100 + spu->height * scaley / 0x100;
+      bbox[3] = dys*spu->sub_pos/100 + spu->height * scaley / 0x100;
       if (bbox[3] > dys) bbox[3] = dys;
       bbox[2] = bbox[3] - spu->height * scaley / 0x100;
       break;
     case 1:
-      if (sub_pos < 50) {
-        bbox[2] = dys*sub_pos/100 - spu->height * scaley / 0x200;
+      if (spu->sub_pos < 50) {
+        bbox[2] = dys*spu->sub_pos/100 - spu->height * scaley / 0x200;
         bbox[3] = bbox[2] + spu->height;
       } else {
-        bbox[3] = dys*sub_pos/100 + spu->height * scaley / 0x200;
+        bbox[3] = dys*spu->sub_pos/100 + spu->height * scaley / 0x200;
         if (bbox[3] > dys) bbox[3] = dys;
         bbox[2] = bbox[3] - spu->height * scaley / 0x100;
       }
       break;
     case 2:
-      bbox[2] = dys*sub_pos/100 - spu->height * scaley / 0x100;
+      bbox[2] = dys*spu->sub_pos/100 - spu->height * scaley / 0x100;
       bbox[3] = bbox[2] + spu->height;
       break;
     default: /* -1 */
@@ -857,6 +1267,52 @@ static void scale_image(int x, int y, scale_pixel* table_x, scale_pixel* table_y
   }
 }
 
+/* R: scale_image for a single gray plane, used to upscale images for the OCR */
+size_t spudec_scale_tables_size(int dw, int dh)
+{
+  return (size_t)(dw + dh) * sizeof(scale_pixel);
+}
+
+void spudec_scale_gray(const uint8_t *src, int src_stride, int w, int h,
+                       uint8_t *dst, int dst_stride, int dw, int dh, void *tables)
+{
+  scale_pixel *table_x = tables;
+  scale_pixel *table_y = table_x + dw;
+  int x, y;
+  if (w < 2 || h < 2 || dw < 2 || dh < 2) {
+    /* scale_table needs at least two pixels, replicate them instead */
+    for (y = 0; y < dh; y++)
+      for (x = 0; x < dw; x++)
+        dst[y * dst_stride + x] = src[(y * h / dh) * src_stride + x * w / dw];
+    return;
+  }
+  scale_table(0, 0, w - 1, dw - 1, table_x);
+  scale_table(0, 0, h - 1, dh - 1, table_y);
+  /* scale_table clamps the last position to end_src - 1 but keeps the
+     weight of the left pixel, which would repeat the second to last pixel */
+  table_x[dw - 1].left_up = 0;
+  table_x[dw - 1].right_down = 0x10000;
+  table_y[dh - 1].left_up = 0;
+  table_y[dh - 1].right_down = 0x10000;
+  for (y = 0; y < dh; y++) {
+    const scale_pixel *ty = &table_y[y];
+    const uint8_t *row = src + ty->position * src_stride;
+    uint8_t *out = dst + y * dst_stride;
+    for (x = 0; x < dw; x++) {
+      const scale_pixel *tx = &table_x[x];
+      const uint8_t *p = row + tx->position;
+      unsigned int scale[4];
+      // weights are at most 0x10000, so the products need 33 bits
+      scale[0] = (uint64_t)tx->left_up * ty->left_up >> 16;
+      scale[1] = (uint64_t)tx->right_down * ty->left_up >> 16;
+      scale[2] = (uint64_t)tx->left_up * ty->right_down >> 16;
+      scale[3] = (uint64_t)tx->right_down * ty->right_down >> 16;
+      out[x] = (p[0] * scale[0] + p[1] * scale[1] +
+                p[src_stride] * scale[2] + p[src_stride + 1] * scale[3]) >> 16;
+    }
+  }
+}
+
 #if 0 // R: removed sws scaling
 static void sws_spu_image(unsigned char *d1, unsigned char *d2, int dw, int dh,
                           int ds, const unsigned char* s1, unsigned char* s2,
@@ -899,7 +1355,7 @@ void spudec_draw_scaled(void *me, unsigned int dxs, unsigned int dys, void (*dra
 	return;
     }
 
-    if (!(spu_aamode&16) && (spu->orig_frame_width == 0 || spu->orig_frame_height == 0
+    if (!(spu->aamode&16) && (spu->orig_frame_width == 0 || spu->orig_frame_height == 0
 	|| (spu->orig_frame_width == dxs && spu->orig_frame_height == dys))) {
       spudec_draw(spu, draw_alpha);
     }
@@ -936,7 +1392,7 @@ void spudec_draw_scaled(void *me, unsigned int dxs, unsigned int dys, void (*dra
 	  if (spu->scaled_width <= 1 || spu->scaled_height <= 1) {
 	    goto nothing_to_do;
 	  }
-	  switch(spu_aamode&15) {
+	  switch(spu->aamode&15) {
 	  case 4:
 #if 0 // R: no swscalar gaussian aa supported
 	  sws_spu_image(spu->scaled_image, spu->scaled_aimage,
@@ -1192,19 +1648,19 @@ nothing_to_do:
 	}
       }
       if (spu->scaled_image){
-        switch (spu_alignment) {
+        switch (spu->alignment) {
         case 0:
-          spu->scaled_start_row = dys*sub_pos/100;
+          spu->scaled_start_row = dys*spu->sub_pos/100;
 	  if (spu->scaled_start_row + spu->scaled_height > dys)
 	    spu->scaled_start_row = dys - spu->scaled_height;
 	  break;
 	case 1:
-          spu->scaled_start_row = dys*sub_pos/100 - spu->scaled_height/2;
-	  if (sub_pos >= 50 && spu->scaled_start_row + spu->scaled_height > dys)
+          spu->scaled_start_row = dys*spu->sub_pos/100 - spu->scaled_height/2;
+	  if (spu->sub_pos >= 50 && spu->scaled_start_row + spu->scaled_height > dys)
 	      spu->scaled_start_row = dys - spu->scaled_height;
 	  break;
         case 2:
-          spu->scaled_start_row = dys*sub_pos/100 - spu->scaled_height;
+          spu->scaled_start_row = dys*spu->sub_pos/100 - spu->scaled_height;
 	  break;
 	}
 	draw_alpha(spu->scaled_start_col, spu->scaled_start_row, spu->scaled_width, spu->scaled_height,
@@ -1232,6 +1688,15 @@ void spudec_update_palette(void * this, unsigned int *palette)
   }
 }
 
+void spudec_set_scaling(void *this, int aamode, int alignment, float gaussvar, int sub_pos)
+{
+  spudec_handle_t *spu = this;
+  spu->aamode = aamode;
+  spu->alignment = alignment;
+  spu->gaussvar = gaussvar;
+  spu->sub_pos = sub_pos;
+}
+
 void spudec_set_font_factor(void * this, double factor)
 {
   spudec_handle_t *spu = this;
@@ -1352,6 +1817,10 @@ void *spudec_new_scaled(unsigned int *palette, unsigned int frame_width, unsigne
   int i;
   spudec_handle_t *this = calloc(1, sizeof(spudec_handle_t));
   if (this){
+    this->aamode = 3;
+    this->alignment = -1;
+    this->gaussvar = 1.0;
+    this->sub_pos = 100;
     this->orig_frame_height = frame_height;
     this->orig_frame_width  = frame_width;
     // set up palette:
@@ -1398,18 +1867,20 @@ void spudec_free(void *this)
   spudec_handle_t *spu = this;
   if (spu) {
     while (spu->queue_head)
-      spudec_free_packet(spudec_dequeue_packet(spu));
+      spudec_free_packet(spu, spudec_dequeue_packet(spu));
     free(spu->packet);
     spu->packet = NULL;
     free(spu->scaled_image);
     spu->scaled_image = NULL;
-    free(spu->image);
+    pool_free(&spu->pool, spu->image_buf);
+    spu->image_buf = NULL;
     spu->image = NULL;
     spu->aimage = NULL;
-    free(spu->pal_image);
+    pool_free(&spu->pool, spu->pal_image);
     spu->pal_image = NULL;
-    spu->image_size = 0;
+    spu->image_size = spu->image_capacity = spu->pal_capacity = 0;
     spu->pal_width = spu->pal_height  = 0;
+    pool_clear(&spu->pool);
     free(spu);
   }
 }
@@ -1455,7 +1926,7 @@ void spudec_set_paletted(void *this, const uint8_t *pal_img, int pal_stride,
   packet->start_row = y;
   packet->data_len = 2 * stride * h;
   if (packet->data_len) { // size 0 is a special "clear" packet
-      packet->packet = malloc(packet->data_len);
+      packet->packet = pool_alloc(&spu->pool, packet->data_len);
       img  = packet->packet;
       aimg = packet->packet + stride * h;
       for (i = 0; i < 256; i++) {
@@ -1467,8 +1938,8 @@ void spudec_set_paletted(void *this, const uint8_t *pal_img, int pal_stride,
           gray = FFMIN(gray, alpha);
           g8a8_pal[i] = (-alpha << 8) | gray;
       }
-      pal2gray_alpha(g8a8_pal, pal_img, pal_stride,
-                     img, aimg, stride, w, h);
+      pal2gray_alpha_c(g8a8_pal, pal_img, pal_stride,
+                       img, aimg, stride, w, h);
   }
   packet->start_pts = 0;
   packet->end_pts = 0x7fffffff;
@@ -1485,10 +1956,23 @@ void spudec_get_data(void *this, const unsigned char **image, size_t *image_size
 {
   spudec_handle_t *spu = this;
   *image = spu->image;
-  *image_size = spu->image_size;
+  // the image is a view into a larger buffer: only report the visible part
+  *image_size = spu->height ? (spu->height - 1) * spu->stride + spu->width : 0;
   *width = spu->width;
   *height = spu->height;
   *stride = spu->stride;
   *start_pts = spu->start_pts;
   *end_pts = spu->end_pts;
 }
+
+void spudec_get_pool_stats(void *this, spudec_pool_stats_t *stats)
+{
+  spudec_handle_t *spu = this;
+  *stats = spu->pool.stats;
+}
+
+void spudec_get_decode_stats(void *this, spudec_decode_stats_t *stats)
+{
+  spudec_handle_t *spu = this;
+  *stats = spu->stats;
+}
@@ -27,6 +27,40 @@
 extern "C" {
 #endif
 
+/// R: statistics of the image/packet buffer pool of a spudec handle
+typedef struct {
+  unsigned long requests;       ///< buffers handed out
+  unsigned long reused;         ///< requests served from the pool
+  unsigned long allocated;      ///< requests that needed a malloc
+  unsigned long released;       ///< buffers given back
+  unsigned long dropped;        ///< released buffers freed instead of cached
+  size_t cached_bytes;          ///< memory currently held by the pool
+} spudec_pool_stats_t;
+
+/// R: what the decoder did and how long it took (CLOCK_MONOTONIC), see spudec_get_decode_stats
+typedef struct {
+  unsigned long fragments;      ///< spudec_assemble calls
+  uint64_t fragment_bytes;      ///< bytes passed to spudec_assemble
+  unsigned long packets;        ///< complete SPU packets
+  unsigned long broken;         ///< fragments and packets dropped as invalid
+  unsigned long images;         ///< images decoded (spudec_process_data or the parallel decoding)
+  uint64_t pixels;              ///< pixels of the decoded images
+  uint64_t assemble_ns;         ///< in spudec_assemble (including the control sequences)
+  uint64_t process_ns;          ///< RLE decoding, palette and cropping, summed over the threads
+  uint64_t drain_ns;            ///< in spudec_drain
+} spudec_decode_stats_t;
+
+/// R: a decoded subtitle as returned by spudec_drain/vobsub_decode_stream
+typedef struct spudec_subtitle {
+  unsigned int start_pts, end_pts; ///< 90kHz, end_pts is UINT_MAX if unknown
+  int packet_pts;                  ///< time stamp of the packet (.idx)
+  unsigned int x, y;               ///< position of the bounding box
+  unsigned int width, height;      ///< bounding box size, height is 0 if empty
+  unsigned int stride;
+  unsigned char *image;            ///< owned gray plane (stride * height bytes)
+  int forced;                      ///< shown by a forced display command
+} spudec_subtitle_t;
+
 void spudec_heartbeat(void *self, unsigned int pts100);
 void spudec_assemble(void *self, unsigned char *packet, unsigned int len, int pts100);
 void spudec_draw(void *self, void (*draw_alpha)(int x0,int y0, int w,int h, unsigned char* src, unsigned char *srca, int stride));
@@ -39,6 +73,8 @@ void spudec_free(void *self);
 void spudec_reset(void *self);	// called after seek
 int spudec_visible(void *self); // check if spu is visible
 void spudec_set_font_factor(void * self, double factor); // sets the equivalent to ffactor
+/// R: replaces the globals spu_aamode, spu_alignment, spu_gaussvar and sub_pos
+void spudec_set_scaling(void *self, int aamode, int alignment, float gaussvar, int sub_pos);
 //void spudec_set_hw_spu(void *self, const vo_functions_t *hw_spu);
 int spudec_changed(void *self);
 void spudec_calc_bbox(void *me, unsigned int dxs, unsigned int dys, unsigned int* bbox);
@@ -47,6 +83,28 @@ void spudec_set_paletted(void *self, const uint8_t *pal_img, int stride,
                          const void *palette,
                          int x, int y, int w, int h,
                          double pts, double endpts);
+/**
+ * R: Batch interface to the decoder.  Decodes every display command queued
+ * by spudec_assemble, independent of the current time, and appends the
+ * cropped images to *subs (*count used of *capacity, grown with realloc).
+ * RLE decoding runs on the threads set with spudec_set_threads.
+ * Returns 0 or -1 on allocation failure.
+ */
+int spudec_drain(void *self, spudec_subtitle_t **subs, size_t *count, size_t *capacity);
+/// R: number of decoder threads used by spudec_drain (0: one per CPU)
+void spudec_set_threads(void *self, int threads);
+/// R: frees an array returned by spudec_drain or vobsub_decode_stream
+void spudec_free_subtitles(spudec_subtitle_t *subs, size_t count);
+void spudec_get_pool_stats(void *self, spudec_pool_stats_t *stats);
+void spudec_get_decode_stats(void *self, spudec_decode_stats_t *stats);
+/**
+ * R: Bilinear scaling of a gray plane (w x h) to dw x dh with the scaler of
+ * spudec_draw_scaled.  tables is scratch memory of
+ * spudec_scale_tables_size(dw, dh) bytes.
+ */
+void spudec_scale_gray(const uint8_t *src, int src_stride, int w, int h,
+                       uint8_t *dst, int dst_stride, int dw, int dh, void *tables);
+size_t spudec_scale_tables_size(int dw, int dh);
 /// call this after spudec_assemble and spudec_heartbeat to get the packet data
 void spudec_get_data(void *self, const unsigned char **image, size_t *image_size, unsigned *width, unsigned *height,
                      unsigned *stride, unsigned *start_pts, unsigned *end_pts);
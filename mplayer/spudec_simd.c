@@ -0,0 +1,450 @@
+/*
+ * R: SIMD kernels for spudec.c. Not part of the original MPlayer code.
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "spudec_simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef void (*pal2gray_alpha_fn)(const uint16_t *pal,
+                                  const uint8_t *src, int src_stride,
+                                  uint8_t *dst, uint8_t *dsta,
+                                  int dst_stride, int w, int h);
+/* index of the first (last) non-zero byte in p[0, n), n (-1) if there is none */
+typedef int (*row_scan_fn)(const uint8_t *p, int n);
+/* dst[x] = src[x] > threshold ? 255 : 0 for x in [0, n) */
+typedef void (*binarize_row_fn)(const uint8_t *src, uint8_t *dst, int n, uint8_t threshold);
+
+/* moved from spudec.c */
+void pal2gray_alpha_c(const uint16_t *pal,
+                      const uint8_t *src, int src_stride,
+                      uint8_t *dst, uint8_t *dsta,
+                      int dst_stride, int w, int h)
+{
+  int x, y;
+  for (y = 0; y < h; y++) {
+    for (x = 0; x < w; x++) {
+      uint16_t pixel = pal[src[x]];
+      *dst++  = pixel;
+      *dsta++ = pixel >> 8;
+    }
+    for (; x < dst_stride; x++)
+      *dsta++ = *dst++ = 0;
+    src += src_stride;
+  }
+}
+
+static int first_nonzero_c(const uint8_t *p, int n)
+{
+  int x;
+  for (x = 0; x < n && !p[x]; x++);
+  return x;
+}
+
+static int last_nonzero_c(const uint8_t *p, int n)
+{
+  int x;
+  for (x = n - 1; x >= 0 && !p[x]; x--);
+  return x;
+}
+
+static void binarize_row_c(const uint8_t *src, uint8_t *dst, int n, uint8_t threshold)
+{
+  int x;
+  for (x = 0; x < n; x++)
+    dst[x] = src[x] > threshold ? 255 : 0;
+}
+
+/* Scalar remainder of a row shared by the vector versions.  x is the first
+   column not handled by the vector loop. */
+static inline void pal2gray_alpha_tail(const uint16_t *pal, const uint8_t *src,
+                                       uint8_t *dst, uint8_t *dsta,
+                                       int x, int dst_stride, int w)
+{
+  for (; x < w; x++) {
+    uint16_t pixel = pal[src[x]];
+    dst[x]  = pixel;
+    dsta[x] = pixel >> 8;
+  }
+  if (dst_stride > w) {
+    memset(dst  + w, 0, dst_stride - w);
+    memset(dsta + w, 0, dst_stride - w);
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("ssse3")))
+static void pal2gray_alpha4_ssse3(const uint16_t *pal,
+                                  const uint8_t *src, int src_stride,
+                                  uint8_t *dst, uint8_t *dsta,
+                                  int dst_stride, int w, int h)
+{
+  const __m128i gray_tbl  = _mm_setr_epi8(pal[0], pal[1], pal[2], pal[3],
+                                          0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i alpha_tbl = _mm_setr_epi8(pal[0] >> 8, pal[1] >> 8, pal[2] >> 8, pal[3] >> 8,
+                                          0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+  int x, y;
+  for (y = 0; y < h; y++) {
+    for (x = 0; x + 16 <= w; x += 16) {
+      __m128i idx = _mm_loadu_si128((const __m128i *)(src + x));
+      _mm_storeu_si128((__m128i *)(dst  + x), _mm_shuffle_epi8(gray_tbl,  idx));
+      _mm_storeu_si128((__m128i *)(dsta + x), _mm_shuffle_epi8(alpha_tbl, idx));
+    }
+    pal2gray_alpha_tail(pal, src, dst, dsta, x, dst_stride, w);
+    src  += src_stride;
+    dst  += dst_stride;
+    dsta += dst_stride;
+  }
+}
+
+__attribute__((target("avx2")))
+static void pal2gray_alpha4_avx2(const uint16_t *pal,
+                                 const uint8_t *src, int src_stride,
+                                 uint8_t *dst, uint8_t *dsta,
+                                 int dst_stride, int w, int h)
+{
+  /* vpshufb works on 128 bit lanes: broadcast the table into both lanes */
+  const __m256i gray_tbl  = _mm256_broadcastsi128_si256(
+    _mm_setr_epi8(pal[0], pal[1], pal[2], pal[3], 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+  const __m256i alpha_tbl = _mm256_broadcastsi128_si256(
+    _mm_setr_epi8(pal[0] >> 8, pal[1] >> 8, pal[2] >> 8, pal[3] >> 8,
+                  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0));
+  int x, y;
+  for (y = 0; y < h; y++) {
+    for (x = 0; x + 32 <= w; x += 32) {
+      __m256i idx = _mm256_loadu_si256((const __m256i *)(src + x));
+      _mm256_storeu_si256((__m256i *)(dst  + x), _mm256_shuffle_epi8(gray_tbl,  idx));
+      _mm256_storeu_si256((__m256i *)(dsta + x), _mm256_shuffle_epi8(alpha_tbl, idx));
+    }
+    pal2gray_alpha_tail(pal, src, dst, dsta, x, dst_stride, w);
+    src  += src_stride;
+    dst  += dst_stride;
+    dsta += dst_stride;
+  }
+}
+
+__attribute__((target("sse2")))
+static int first_nonzero_sse2(const uint8_t *p, int n)
+{
+  const __m128i zero = _mm_setzero_si128();
+  int x;
+  for (x = 0; x + 16 <= n; x += 16) {
+    unsigned m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + x)), zero)) & 0xffff;
+    if (m)
+      return x + __builtin_ctz(m);
+  }
+  return x + first_nonzero_c(p + x, n - x);
+}
+
+__attribute__((target("sse2")))
+static int last_nonzero_sse2(const uint8_t *p, int n)
+{
+  const __m128i zero = _mm_setzero_si128();
+  int x = n;
+  while (x >= 16) {
+    unsigned m;
+    x -= 16;
+    m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + x)), zero)) & 0xffff;
+    if (m)
+      return x + 31 - __builtin_clz(m);
+  }
+  return last_nonzero_c(p, x);
+}
+
+__attribute__((target("avx2")))
+static int first_nonzero_avx2(const uint8_t *p, int n)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  int x;
+  for (x = 0; x + 32 <= n; x += 32) {
+    unsigned m = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + x)), zero));
+    if (m)
+      return x + __builtin_ctz(m);
+  }
+  return x + first_nonzero_c(p + x, n - x);
+}
+
+__attribute__((target("avx2")))
+static int last_nonzero_avx2(const uint8_t *p, int n)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  int x = n;
+  while (x >= 32) {
+    unsigned m;
+    x -= 32;
+    m = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + x)), zero));
+    if (m)
+      return x + 31 - __builtin_clz(m);
+  }
+  return last_nonzero_c(p, x);
+}
+
+/* unsigned src > threshold is max(src, threshold + 1) == src, threshold < 255 */
+__attribute__((target("sse2")))
+static void binarize_row_sse2(const uint8_t *src, uint8_t *dst, int n, uint8_t threshold)
+{
+  const __m128i t = _mm_set1_epi8((char)(threshold + 1));
+  int x;
+  for (x = 0; x + 16 <= n; x += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + x));
+    _mm_storeu_si128((__m128i *)(dst + x), _mm_cmpeq_epi8(_mm_max_epu8(v, t), v));
+  }
+  binarize_row_c(src + x, dst + x, n - x, threshold);
+}
+
+__attribute__((target("avx2")))
+static void binarize_row_avx2(const uint8_t *src, uint8_t *dst, int n, uint8_t threshold)
+{
+  const __m256i t = _mm256_set1_epi8((char)(threshold + 1));
+  int x;
+  for (x = 0; x + 32 <= n; x += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(src + x));
+    _mm256_storeu_si256((__m256i *)(dst + x), _mm256_cmpeq_epi8(_mm256_max_epu8(v, t), v));
+  }
+  binarize_row_c(src + x, dst + x, n - x, threshold);
+}
+#endif /* HAVE_X86_SIMD */
+
+#ifdef HAVE_NEON
+static void pal2gray_alpha4_neon(const uint16_t *pal,
+                                 const uint8_t *src, int src_stride,
+                                 uint8_t *dst, uint8_t *dsta,
+                                 int dst_stride, int w, int h)
+{
+  const uint8_t gray[8]  = { pal[0], pal[1], pal[2], pal[3], 0, 0, 0, 0 };
+  const uint8_t alpha[8] = { pal[0] >> 8, pal[1] >> 8, pal[2] >> 8, pal[3] >> 8, 0, 0, 0, 0 };
+  const uint8x8_t gray_tbl  = vld1_u8(gray);
+  const uint8x8_t alpha_tbl = vld1_u8(alpha);
+  int x, y;
+  for (y = 0; y < h; y++) {
+    for (x = 0; x + 16 <= w; x += 16) {
+      uint8x16_t idx = vld1q_u8(src + x);
+      vst1q_u8(dst  + x, vcombine_u8(vtbl1_u8(gray_tbl,  vget_low_u8(idx)),
+                                     vtbl1_u8(gray_tbl,  vget_high_u8(idx))));
+      vst1q_u8(dsta + x, vcombine_u8(vtbl1_u8(alpha_tbl, vget_low_u8(idx)),
+                                     vtbl1_u8(alpha_tbl, vget_high_u8(idx))));
+    }
+    pal2gray_alpha_tail(pal, src, dst, dsta, x, dst_stride, w);
+    src  += src_stride;
+    dst  += dst_stride;
+    dsta += dst_stride;
+  }
+}
+
+/* test 16 bytes at once and locate the byte inside the chunk with scalar code */
+static int first_nonzero_neon(const uint8_t *p, int n)
+{
+  int x;
+  for (x = 0; x + 16 <= n; x += 16) {
+    uint8x16_t v = vld1q_u8(p + x);
+    uint8x8_t m = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+    if (vget_lane_u64(vreinterpret_u64_u8(m), 0))
+      return x + first_nonzero_c(p + x, 16);
+  }
+  return x + first_nonzero_c(p + x, n - x);
+}
+
+static int last_nonzero_neon(const uint8_t *p, int n)
+{
+  int x = n;
+  while (x >= 16) {
+    uint8x16_t v;
+    uint8x8_t m;
+    x -= 16;
+    v = vld1q_u8(p + x);
+    m = vorr_u8(vget_low_u8(v), vget_high_u8(v));
+    if (vget_lane_u64(vreinterpret_u64_u8(m), 0))
+      return x + last_nonzero_c(p + x, 16);
+  }
+  return last_nonzero_c(p, x);
+}
+
+static void binarize_row_neon(const uint8_t *src, uint8_t *dst, int n, uint8_t threshold)
+{
+  const uint8x16_t t = vdupq_n_u8(threshold);
+  int x;
+  for (x = 0; x + 16 <= n; x += 16)
+    vst1q_u8(dst + x, vcgtq_u8(vld1q_u8(src + x), t));
+  binarize_row_c(src + x, dst + x, n - x, threshold);
+}
+#endif /* HAVE_NEON */
+
+static int simd_level = SPUDEC_SIMD_NONE;
+static pal2gray_alpha_fn pal2gray_alpha4_impl = pal2gray_alpha_c;
+static row_scan_fn first_nonzero_impl = first_nonzero_c;
+static row_scan_fn last_nonzero_impl = last_nonzero_c;
+static binarize_row_fn binarize_row_impl = binarize_row_c;
+static pthread_once_t simd_once = PTHREAD_ONCE_INIT;
+
+int spudec_simd_detect(void)
+{
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return SPUDEC_SIMD_AVX2;
+  if (__builtin_cpu_supports("ssse3"))
+    return SPUDEC_SIMD_SSSE3;
+#endif
+#ifdef HAVE_NEON
+  return SPUDEC_SIMD_NEON;
+#endif
+  return SPUDEC_SIMD_NONE;
+}
+
+static int simd_supported(int level)
+{
+  int best = spudec_simd_detect();
+  if (level == SPUDEC_SIMD_NONE)
+    return 1;
+  if (best == SPUDEC_SIMD_NEON)
+    return level == SPUDEC_SIMD_NEON;
+  return level != SPUDEC_SIMD_NEON && level <= best;
+}
+
+static int simd_set(int level)
+{
+  if (!simd_supported(level))
+    level = SPUDEC_SIMD_NONE;
+  switch (level) {
+#ifdef HAVE_X86_SIMD
+  case SPUDEC_SIMD_SSSE3:
+    pal2gray_alpha4_impl = pal2gray_alpha4_ssse3;
+    first_nonzero_impl = first_nonzero_sse2;
+    last_nonzero_impl = last_nonzero_sse2;
+    binarize_row_impl = binarize_row_sse2;
+    break;
+  case SPUDEC_SIMD_AVX2:
+    pal2gray_alpha4_impl = pal2gray_alpha4_avx2;
+    first_nonzero_impl = first_nonzero_avx2;
+    last_nonzero_impl = last_nonzero_avx2;
+    binarize_row_impl = binarize_row_avx2;
+    break;
+#endif
+#ifdef HAVE_NEON
+  case SPUDEC_SIMD_NEON:
+    pal2gray_alpha4_impl = pal2gray_alpha4_neon;
+    first_nonzero_impl = first_nonzero_neon;
+    last_nonzero_impl = last_nonzero_neon;
+    binarize_row_impl = binarize_row_neon;
+    break;
+#endif
+  default:
+    level = SPUDEC_SIMD_NONE;
+    pal2gray_alpha4_impl = pal2gray_alpha_c;
+    first_nonzero_impl = first_nonzero_c;
+    last_nonzero_impl = last_nonzero_c;
+    binarize_row_impl = binarize_row_c;
+  }
+  simd_level = level;
+  return level;
+}
+
+static void simd_init(void)
+{
+  simd_set(spudec_simd_detect());
+}
+
+int spudec_simd_select(int level)
+{
+  pthread_once(&simd_once, simd_init);
+  return simd_set(level);
+}
+
+int spudec_simd_level(void)
+{
+  pthread_once(&simd_once, simd_init);
+  return simd_level;
+}
+
+const char *spudec_simd_name(int level)
+{
+  switch (level) {
+  case SPUDEC_SIMD_SSSE3: return "ssse3";
+  case SPUDEC_SIMD_AVX2:  return "avx2";
+  case SPUDEC_SIMD_NEON:  return "neon";
+  default:                return "none";
+  }
+}
+
+void pal2gray_alpha4(const uint16_t *pal,
+                     const uint8_t *src, int src_stride,
+                     uint8_t *dst, uint8_t *dsta,
+                     int dst_stride, int w, int h)
+{
+  pthread_once(&simd_once, simd_init);
+  pal2gray_alpha4_impl(pal, src, src_stride, dst, dsta, dst_stride, w, h);
+}
+
+int spudec_find_bbox(const uint8_t *plane, int stride, int w, int h,
+                     int *x0, int *y0, int *x1, int *y1)
+{
+  int top, bottom, left, right, y;
+  const uint8_t *row;
+  pthread_once(&simd_once, simd_init);
+  if (w <= 0 || h <= 0)
+    return 0;
+  for (top = 0; top < h && first_nonzero_impl(plane + top * stride, w) == w; top++);
+  if (top == h)
+    return 0;
+  for (bottom = h - 1; bottom > top && last_nonzero_impl(plane + bottom * stride, w) < 0; bottom--);
+  /* Only the margins outside of the box found so far need to be scanned. */
+  left = w;
+  right = -1;
+  for (y = top, row = plane + top * stride; y <= bottom; y++, row += stride) {
+    if (left > 0) {
+      int x = first_nonzero_impl(row, left);
+      if (x < left)
+        left = x;
+    }
+    if (right < w - 1) {
+      int x = last_nonzero_impl(row + right + 1, w - right - 1);
+      if (x >= 0)
+        right += x + 1;
+    }
+  }
+  *x0 = left;
+  *y0 = top;
+  *x1 = right;
+  *y1 = bottom;
+  return 1;
+}
+
+void spudec_binarize(const uint8_t *src, int src_stride,
+                     uint8_t *dst, int dst_stride,
+                     int w, int h, uint8_t threshold)
+{
+  binarize_row_fn row = binarize_row_c;
+  int y;
+  pthread_once(&simd_once, simd_init);
+  if (threshold < 255) /* the vector versions compare with threshold + 1 */
+    row = binarize_row_impl;
+  for (y = 0; y < h; y++, src += src_stride, dst += dst_stride)
+    row(src, dst, w, threshold);
+}
@@ -0,0 +1,88 @@
+/*
+ * R: SIMD kernels for spudec.c. Not part of the original MPlayer code.
+ *
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_SPUDEC_SIMD_H
+#define MPLAYER_SPUDEC_SIMD_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Instruction set levels understood by spudec_simd_select */
+#define SPUDEC_SIMD_NONE  0
+#define SPUDEC_SIMD_SSSE3 1
+#define SPUDEC_SIMD_AVX2  2
+#define SPUDEC_SIMD_NEON  3
+
+/// Returns the best instruction set level supported by the running CPU.
+int spudec_simd_detect(void);
+/// Force a level (e.g. SPUDEC_SIMD_NONE to get the reference code).
+/// Falls back to the scalar code if the level is not supported.  Returns the
+/// selected level.  Not thread-safe, call it before decoding starts.
+int spudec_simd_select(int level);
+/// Returns the currently selected level.
+int spudec_simd_level(void);
+/// Name of a level for diagnostics.
+const char *spudec_simd_name(int level);
+
+/**
+ * Convert a paletted image into separate gray and alpha planes.
+ *
+ * \param pal palette in MPlayer-style gray-alpha values (gray in the low byte,
+ *            alpha in the high byte).
+ * Pixels in [w, dst_stride) are set to zero in both planes.
+ *
+ * pal2gray_alpha_c is the reference implementation and accepts any palette
+ * index in src.  pal2gray_alpha4 only accepts indices 0-3 (as produced by the
+ * RLE decoder) and uses the fastest available implementation.
+ */
+void pal2gray_alpha_c(const uint16_t *pal,
+                      const uint8_t *src, int src_stride,
+                      uint8_t *dst, uint8_t *dsta,
+                      int dst_stride, int w, int h);
+void pal2gray_alpha4(const uint16_t *pal,
+                     const uint8_t *src, int src_stride,
+                     uint8_t *dst, uint8_t *dsta,
+                     int dst_stride, int w, int h);
+
+/**
+ * Find the bounding box of the non-zero pixels of a w x h plane.
+ *
+ * On success the inclusive box is stored in x0/y0/x1/y1 and 1 is returned.
+ * Returns 0 if all pixels are zero.
+ */
+int spudec_find_bbox(const uint8_t *plane, int stride, int w, int h,
+                     int *x0, int *y0, int *x1, int *y1);
+
+/**
+ * Binarize a w x h plane: pixels above threshold become 255, all others 0.
+ * Uses the fastest available implementation.
+ */
+void spudec_binarize(const uint8_t *src, int src_stride,
+                     uint8_t *dst, int dst_stride,
+                     int w, int h, uint8_t threshold);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MPLAYER_SPUDEC_SIMD_H */
@@ -31,6 +31,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 
 //#include "config.h"
 #define CONFIG_UNRAR_EXEC 1 // moved from config.h
@@ -40,12 +41,6 @@
 #include "mp_msg.h"
 #include "unrar_exec.h"
 
-// Record the original -vobsubid set by commandline, since vobsub_id will be
-// overridden if slang match any of vobsub streams.
-static int vobsubid = -2;
-
-int vobsub_id = 0; // moved from mpcommon.h/mplayer.c
-
 /**********************************************************************
  * RAR stream handling
  * The RAR file must have the same basename as the file to open
@@ -143,10 +138,13 @@ static rar_stream_t *rar_open(const char *const filename,
 
 static int rar_close(rar_stream_t *stream)
 {
+    int res = 0;
     if (stream->file)
-        return fclose(stream->file);
-    free(stream->data);
-    return 0;
+        res = fclose(stream->file);
+    else
+        free(stream->data);
+    free(stream); // R: the stream itself was leaked
+    return res;
 }
 
 static int rar_eof(rar_stream_t *stream)
@@ -224,8 +222,28 @@ static size_t rar_read(void *ptr, size_t size, size_t nmemb,
     return res;
 }
 
+/* R: a stream on a copy of size bytes of data (vobsub_open_memory) */
+static rar_stream_t *rar_open_memory(const void *data, size_t size)
+{
+    rar_stream_t *stream = malloc(sizeof(rar_stream_t));
+    if (stream == NULL)
+        return NULL;
+    stream->file = NULL;
+    stream->data = malloc(size ? size : 1);
+    if (stream->data == NULL) {
+        free(stream);
+        return NULL;
+    }
+    if (size)
+        memcpy(stream->data, data, size);
+    stream->size = size;
+    stream->pos = 0;
+    return stream;
+}
+
 #else
 typedef FILE rar_stream_t;
+#define rar_open_memory(data, size) fmemopen((void *)(data), size, "rb")
 #define rar_open        fopen
 #define rar_close       fclose
 #define rar_eof         feof
@@ -290,26 +308,36 @@ typedef struct {
     int merge;
 } mpeg_t;
 
+/* R: takes ownership of stream (split out of mpeg_open) */
+static mpeg_t *mpeg_open_stream(rar_stream_t *stream)
+{
+    mpeg_t *res;
+    if (stream == NULL)
+        return NULL;
+    res = malloc(sizeof(mpeg_t));
+    if (res == NULL) {
+        rar_close(stream);
+        return NULL;
+    }
+    res->pts            = 0;
+    res->aid            = -1;
+    res->packet         = NULL;
+    res->packet_size    = 0;
+    res->packet_reserve = 0;
+    res->padding_was_here = 1;
+    res->merge          = 0;
+    res->stream         = stream;
+    return res;
+}
+
 static mpeg_t *mpeg_open(const char *filename)
 {
-    mpeg_t *res = malloc(sizeof(mpeg_t));
-    int err = res == NULL;
-    if (!err) {
-        res->pts            = 0;
-        res->aid            = -1;
-        res->packet         = NULL;
-        res->packet_size    = 0;
-        res->packet_reserve = 0;
-        res->padding_was_here = 1;
-        res->merge          = 0;
-        res->stream         = rar_open(filename, "rb");
-        err = res->stream == NULL;
-        if (err)
-            perror("fopen Vobsub file failed");
-        if (err)
-            free(res);
+    rar_stream_t *stream = rar_open(filename, "rb");
+    if (stream == NULL) {
+        perror("fopen Vobsub file failed");
+        return NULL;
     }
-    return err ? NULL : res;
+    return mpeg_open_stream(stream);
 }
 
 static void mpeg_free(mpeg_t *mpeg)
@@ -530,6 +558,7 @@ static void packet_queue_destroy(packet_queue_t *queue)
             packet_destroy(queue->packets + queue->packets_size);
         free(queue->packets);
     }
+    free(queue->id); // R: was leaked
     return;
 }
 
@@ -602,8 +631,25 @@ typedef struct {
     unsigned int spu_streams_size;
     unsigned int spu_streams_current;
     unsigned int spu_valid_streams_size;
+    /* R: the selected stream and the originally requested stream were the
+       process globals vobsub_id and vobsubid.  Moved here to make the
+       handle reentrant. */
+    int spu_stream_id;
+    int spu_stream_requested;
+    /* R: kept to create further decoders with vobsub_spudec_new */
+    unsigned char *extradata;
+    unsigned int extradata_len;
+    vobsub_stats_t stats; /* R: see vobsub_get_stats */
 } vobsub_t;
 
+/* R: monotonic clock for vobsub_stats_t */
+static uint64_t vobsub_clock_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
 /* Make sure that the spu stream idx exists. */
 static int vobsub_ensure_spu_stream(vobsub_t *vob, unsigned int index)
 {
@@ -813,10 +859,10 @@ static int vobsub_parse_delay(vobsub_t *vob, const char *line)
     return 0;
 }
 
-static int vobsub_set_lang(const char *line)
+static int vobsub_set_lang(vobsub_t *vob, const char *line)
 {
-    if (vobsub_id == -1)
-        vobsub_id = atoi(line + 8); // 8 == strlen("langidx:")
+    if (vob->spu_stream_id == -1)
+        vob->spu_stream_id = atoi(line + 8); // 8 == strlen("langidx:")
     return 0;
 }
 
@@ -849,7 +895,7 @@ static int vobsub_parse_one_line(vobsub_t *vob, rar_stream_t *fd,
         if (*line == 0 || *line == '\r' || *line == '\n' || *line == '#')
             continue;
         else if (strncmp("langidx:", line, 8) == 0)
-            res = vobsub_set_lang(line);
+            res = vobsub_set_lang(vob, line);
         else if (strncmp("delay:", line, 6) == 0)
             res = vobsub_parse_delay(vob, line);
         else if (strncmp("id:", line, 3) == 0)
@@ -945,6 +991,86 @@ int vobsub_parse_ifo(void* this, const char *const name, unsigned int *palette,
     return res;
 }
 
+/* R: parses the .idx (split out of vobsub_open) */
+static void vobsub_read_idx(vobsub_t *vob, rar_stream_t *fd,
+                            unsigned char **extradata,
+                            unsigned int *extradata_len)
+{
+    uint64_t start = vobsub_clock_ns();
+    while (vobsub_parse_one_line(vob, fd, extradata, extradata_len) >= 0)
+        ++vob->stats.idx_lines;
+    vob->stats.idx_ns = vobsub_clock_ns() - start;
+}
+
+/* R: reads the packets of the .sub into the streams (split out of vobsub_open) */
+static void vobsub_read_sub(vobsub_t *vob, mpeg_t *mpg)
+{
+    long last_pts_diff = 0;
+    while (!mpeg_eof(mpg)) {
+        off_t pos = mpeg_tell(mpg);
+        uint64_t start = vobsub_clock_ns();
+        int run = mpeg_run(mpg);
+        vob->stats.mpeg_run_ns += vobsub_clock_ns() - start;
+        if (run < 0) {
+            if (!mpeg_eof(mpg))
+                mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: mpeg_run error\n");
+            break;
+        }
+        ++vob->stats.mpeg_packets;
+        if (mpg->packet_size) {
+            if ((mpg->aid & 0xe0) == 0x20) {
+                unsigned int sid = mpg->aid & 0x1f;
+                if (vobsub_ensure_spu_stream(vob, sid) >= 0)  {
+                    packet_queue_t *queue = vob->spu_streams + sid;
+                    /* get the packet to fill */
+                    if (queue->packets_size == 0 && packet_queue_grow(queue)  < 0)
+                      abort();
+                    while (queue->current_index + 1 < queue->packets_size
+                           && queue->packets[queue->current_index + 1].filepos <= pos)
+                        ++queue->current_index;
+                    if (queue->current_index < queue->packets_size) {
+                        packet_t *pkt;
+                        if (queue->packets[queue->current_index].data) {
+                            /* insert a new packet and fix the PTS ! */
+                            packet_queue_insert(queue);
+                            queue->packets[queue->current_index].pts100 =
+                                mpg->pts + last_pts_diff;
+                        }
+                        pkt = queue->packets + queue->current_index;
+                        if (pkt->pts100 != UINT_MAX) {
+                            if (queue->packets_size > 1)
+                                last_pts_diff = pkt->pts100 - mpg->pts;
+                            else
+                                pkt->pts100 = mpg->pts;
+                            if (mpg->merge && queue->current_index > 0) {
+                                packet_t *last = &queue->packets[queue->current_index - 1];
+                                pkt->pts100 = last->pts100;
+                            }
+                            mpg->merge = 0;
+                            /* FIXME: should not use mpg_sub internal informations, make a copy */
+                            pkt->data = mpg->packet;
+                            pkt->size = mpg->packet_size;
+                            ++vob->stats.spu_packets;
+                            mpg->packet = NULL;
+                            mpg->packet_reserve = 0;
+                            mpg->packet_size = 0;
+                        }
+                    }
+                } else
+                    mp_msg(MSGT_VOBSUB, MSGL_WARN, "don't know what to do with subtitle #%u\n", sid);
+            }
+        }
+    }
+    vob->spu_streams_current = vob->spu_streams_size;
+    while (vob->spu_streams_current-- > 0) {
+        vob->spu_streams[vob->spu_streams_current].current_index = 0;
+        if (vob->spu_stream_requested == vob->spu_streams_current ||
+            vob->spu_streams[vob->spu_streams_current].packets_size > 0)
+            ++vob->spu_valid_streams_size;
+    }
+    vob->stats.sub_bytes = mpeg_tell(mpg);
+}
+
 void *vobsub_open(const char *const name, const char *const ifo,
                   const int force, unsigned int y_threshold, void** spu)
 {
@@ -953,8 +1079,6 @@ void *vobsub_open(const char *const name, const char *const ifo,
     vobsub_t *vob = calloc(1, sizeof(vobsub_t));
     if (spu)
         *spu = NULL;
-    if (vobsubid == -2)
-        vobsubid = vobsub_id;
     if (vob) {
         char *buf;
         buf = malloc(strlen(name) + 5);
@@ -981,14 +1105,13 @@ void *vobsub_open(const char *const name, const char *const ifo,
                     return NULL;
                 }
             } else {
-                while (vobsub_parse_one_line(vob, fd, &extradata, &extradata_len) >= 0)
-                    /* NOOP */ ;
+                vobsub_read_idx(vob, fd, &extradata, &extradata_len);
                 rar_close(fd);
             }
             if (spu)
                 *spu = spudec_new_scaled(vob->palette, vob->orig_frame_width, vob->orig_frame_height, extradata, extradata_len, y_threshold);
-            if (extradata)
-                free(extradata);
+            vob->extradata = extradata;
+            vob->extradata_len = extradata_len;
 
             /* read the indexed mpeg_stream */
             strcpy(buf, name);
@@ -999,68 +1122,12 @@ void *vobsub_open(const char *const name, const char *const ifo,
                     mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: Can't open SUB file\n");
                 else {
                     free(buf);
+                    free(vob->extradata);
                     free(vob);
                     return NULL;
                 }
             } else {
-                long last_pts_diff = 0;
-                while (!mpeg_eof(mpg)) {
-                    off_t pos = mpeg_tell(mpg);
-                    if (mpeg_run(mpg) < 0) {
-                        if (!mpeg_eof(mpg))
-                            mp_msg(MSGT_VOBSUB, MSGL_ERR, "VobSub: mpeg_run error\n");
-                        break;
-                    }
-                    if (mpg->packet_size) {
-                        if ((mpg->aid & 0xe0) == 0x20) {
-                            unsigned int sid = mpg->aid & 0x1f;
-                            if (vobsub_ensure_spu_stream(vob, sid) >= 0)  {
-                                packet_queue_t *queue = vob->spu_streams + sid;
-                                /* get the packet to fill */
-                                if (queue->packets_size == 0 && packet_queue_grow(queue)  < 0)
-                                  abort();
-                                while (queue->current_index + 1 < queue->packets_size
-                                       && queue->packets[queue->current_index + 1].filepos <= pos)
-                                    ++queue->current_index;
-                                if (queue->current_index < queue->packets_size) {
-                                    packet_t *pkt;
-                                    if (queue->packets[queue->current_index].data) {
-                                        /* insert a new packet and fix the PTS ! */
-                                        packet_queue_insert(queue);
-                                        queue->packets[queue->current_index].pts100 =
-                                            mpg->pts + last_pts_diff;
-                                    }
-                                    pkt = queue->packets + queue->current_index;
-                                    if (pkt->pts100 != UINT_MAX) {
-                                        if (queue->packets_size > 1)
-                                            last_pts_diff = pkt->pts100 - mpg->pts;
-                                        else
-                                            pkt->pts100 = mpg->pts;
-                                        if (mpg->merge && queue->current_index > 0) {
-                                            packet_t *last = &queue->packets[queue->current_index - 1];
-                                            pkt->pts100 = last->pts100;
-                                        }
-                                        mpg->merge = 0;
-                                        /* FIXME: should not use mpg_sub internal informations, make a copy */
-                                        pkt->data = mpg->packet;
-                                        pkt->size = mpg->packet_size;
-                                        mpg->packet = NULL;
-                                        mpg->packet_reserve = 0;
-                                        mpg->packet_size = 0;
-                                    }
-                                }
-                            } else
-                                mp_msg(MSGT_VOBSUB, MSGL_WARN, "don't know what to do with subtitle #%u\n", sid);
-                        }
-                    }
-                }
-                vob->spu_streams_current = vob->spu_streams_size;
-                while (vob->spu_streams_current-- > 0) {
-                    vob->spu_streams[vob->spu_streams_current].current_index = 0;
-                    if (vobsubid == vob->spu_streams_current ||
-                        vob->spu_streams[vob->spu_streams_current].packets_size > 0)
-                        ++vob->spu_valid_streams_size;
-                }
+                vobsub_read_sub(vob, mpg);
                 mpeg_free(mpg);
             }
             free(buf);
@@ -1069,6 +1136,42 @@ void *vobsub_open(const char *const name, const char *const ifo,
     return vob;
 }
 
+/* R: vobsub_open on the contents of the .idx and .sub, without an .ifo */
+void *vobsub_open_memory(const char *idx, size_t idx_len,
+                         const unsigned char *sub, size_t sub_len,
+                         unsigned int y_threshold, void **spu)
+{
+    unsigned char *extradata = NULL;
+    unsigned int extradata_len = 0;
+    rar_stream_t *fd;
+    mpeg_t *mpg;
+    vobsub_t *vob = calloc(1, sizeof(vobsub_t));
+    if (spu)
+        *spu = NULL;
+    if (vob == NULL)
+        return NULL;
+    fd = rar_open_memory(idx, idx_len);
+    mpg = mpeg_open_stream(rar_open_memory(sub, sub_len));
+    if (fd == NULL || mpg == NULL) {
+        mp_msg(MSGT_VOBSUB, MSGL_FATAL, "vobsub_open_memory: malloc failure");
+        if (fd)
+            rar_close(fd);
+        if (mpg)
+            mpeg_free(mpg);
+        free(vob);
+        return NULL;
+    }
+    vobsub_read_idx(vob, fd, &extradata, &extradata_len);
+    rar_close(fd);
+    if (spu)
+        *spu = spudec_new_scaled(vob->palette, vob->orig_frame_width, vob->orig_frame_height, extradata, extradata_len, y_threshold);
+    vob->extradata = extradata;
+    vob->extradata_len = extradata_len;
+    vobsub_read_sub(vob, mpg);
+    mpeg_free(mpg);
+    return vob;
+}
+
 void vobsub_close(void *this)
 {
     vobsub_t *vob = this;
@@ -1077,9 +1180,16 @@ void vobsub_close(void *this)
             packet_queue_destroy(vob->spu_streams + vob->spu_streams_size);
         free(vob->spu_streams);
     }
+    free(vob->extradata);
     free(vob);
 }
 
+void vobsub_get_stats(void *vobhandle, vobsub_stats_t *stats)
+{
+    vobsub_t *vob = vobhandle;
+    *stats = vob->stats;
+}
+
 unsigned int vobsub_get_indexes_count(void *vobhandle)
 {
     vobsub_t *vob = vobhandle;
@@ -1099,7 +1209,7 @@ int vobsub_get_id_by_index(void *vobhandle, unsigned int index)
     if (vob == NULL)
         return -1;
     for (i = 0, j = 0; i < vob->spu_streams_size; ++i)
-        if (i == vobsubid || vob->spu_streams[i].packets_size > 0) {
+        if (i == vob->spu_stream_requested || vob->spu_streams[i].packets_size > 0) {
             if (j == index)
                 return i;
             ++j;
@@ -1113,10 +1223,10 @@ int vobsub_get_index_by_id(void *vobhandle, int id)
     int i, j;
     if (vob == NULL || id < 0 || id >= vob->spu_streams_size)
         return -1;
-    if (id != vobsubid && !vob->spu_streams[id].packets_size)
+    if (id != vob->spu_stream_requested && !vob->spu_streams[id].packets_size)
         return -1;
     for (i = 0, j = 0; i < id; ++i)
-        if (i == vobsubid || vob->spu_streams[i].packets_size > 0)
+        if (i == vob->spu_stream_requested || vob->spu_streams[i].packets_size > 0)
             ++j;
     return j;
 }
@@ -1129,7 +1239,7 @@ int vobsub_set_from_lang(void *vobhandle, char const *lang)
         for (i = 0; i < vob->spu_streams_size; i++)
             if (vob->spu_streams[i].id)
                 if ((strncmp(vob->spu_streams[i].id, lang, 2) == 0)) {
-                    vobsub_id = i;
+                    vob->spu_stream_id = i;
                     mp_msg(MSGT_VOBSUB, MSGL_INFO, "Selected VOBSUB language: %d language: %s\n", i, vob->spu_streams[i].id);
                     return 0;
                 }
@@ -1175,8 +1285,8 @@ int vobsub_get_packet(void *vobhandle, float pts, void** data, int* timestamp)
 {
     vobsub_t *vob = vobhandle;
     unsigned int pts100 = 90000 * pts;
-    if (vob->spu_streams && 0 <= vobsub_id && (unsigned) vobsub_id < vob->spu_streams_size) {
-        packet_queue_t *queue = vob->spu_streams + vobsub_id;
+    if (vob->spu_streams && 0 <= vob->spu_stream_id && (unsigned) vob->spu_stream_id < vob->spu_streams_size) {
+        packet_queue_t *queue = vob->spu_streams + vob->spu_stream_id;
 
         vobsub_queue_reseek(queue, pts100);
 
@@ -1200,8 +1310,14 @@ int vobsub_get_packet(void *vobhandle, float pts, void** data, int* timestamp)
 int vobsub_get_next_packet(void *vobhandle, void** data, int* timestamp)
 {
     vobsub_t *vob = vobhandle;
-    if (vob->spu_streams && 0 <= vobsub_id && (unsigned) vobsub_id < vob->spu_streams_size) {
-        packet_queue_t *queue = vob->spu_streams + vobsub_id;
+    return vobsub_get_next_packet_stream(vob, vob->spu_stream_id, data, timestamp);
+}
+
+int vobsub_get_next_packet_stream(void *vobhandle, int stream, void** data, int* timestamp)
+{
+    vobsub_t *vob = vobhandle;
+    if (vob->spu_streams && 0 <= stream && (unsigned) stream < vob->spu_streams_size) {
+        packet_queue_t *queue = vob->spu_streams + stream;
         if (queue->current_index < queue->packets_size) {
             packet_t *pkt = queue->packets + queue->current_index;
             ++queue->current_index;
@@ -1219,16 +1335,68 @@ void vobsub_seek(void * vobhandle, float pts)
     packet_queue_t * queue;
     int seek_pts100 = pts * 90000;
 
-    if (vob->spu_streams && 0 <= vobsub_id && (unsigned) vobsub_id < vob->spu_streams_size) {
+    if (vob->spu_streams && 0 <= vob->spu_stream_id && (unsigned) vob->spu_stream_id < vob->spu_streams_size) {
         /* do not seek if we don't know the id */
-        if (vobsub_get_id(vob, vobsub_id) == NULL)
+        if (vobsub_get_id(vob, vob->spu_stream_id) == NULL)
             return;
-        queue = vob->spu_streams + vobsub_id;
+        queue = vob->spu_streams + vob->spu_stream_id;
         queue->current_index = 0;
         vobsub_queue_reseek(queue, seek_pts100);
     }
 }
 
+int vobsub_get_stream(void *vobhandle)
+{
+    vobsub_t *vob = vobhandle;
+    return vob->spu_stream_id;
+}
+
+void vobsub_set_stream(void *vobhandle, int stream)
+{
+    vobsub_t *vob = vobhandle;
+    vob->spu_stream_id = stream;
+}
+
+void vobsub_reset_stream(void *vobhandle, int stream)
+{
+    vobsub_t *vob = vobhandle;
+    if (vob->spu_streams && 0 <= stream && (unsigned) stream < vob->spu_streams_size)
+        vob->spu_streams[stream].current_index = 0;
+}
+
+int vobsub_decode_stream(void *vobhandle, void *spu, int stream,
+                         struct spudec_subtitle **subs)
+{
+    vobsub_t *vob = vobhandle;
+    spudec_subtitle_t *list = NULL;
+    size_t count = 0, capacity = 0;
+    void *packet;
+    int timestamp, len;
+
+    *subs = NULL;
+    vobsub_reset_stream(vob, stream);
+    spudec_reset(spu);
+    while ((len = vobsub_get_next_packet_stream(vob, stream, &packet, &timestamp)) > 0) {
+        if (timestamp < 0)
+            continue;
+        spudec_assemble(spu, packet, len, timestamp);
+    }
+    /* decode everything at once, so the RLE decoding can run in parallel */
+    if (spudec_drain(spu, &list, &count, &capacity) < 0) {
+        spudec_free_subtitles(list, count);
+        return -1;
+    }
+    *subs = list;
+    return count;
+}
+
+void *vobsub_spudec_new(void *vobhandle, unsigned int y_threshold)
+{
+    vobsub_t *vob = vobhandle;
+    return spudec_new_scaled(vob->palette, vob->orig_frame_width, vob->orig_frame_height,
+                             vob->extradata, vob->extradata_len, y_threshold);
+}
+
 void vobsub_reset(void *vobhandle)
 {
     vobsub_t *vob = vobhandle;
@@ -1239,15 +1407,23 @@ void vobsub_reset(void *vobhandle)
     }
 }
 
-#if 0 // R: no output needed
 /**********************************************************************
  * Vobsub output
  **********************************************************************/
 
+/* R: revived for the corpus generator (vobsub2srt-corpus).  The statics of
+   vobsub_out_output are now part of the handle, so several handles can be
+   used one after the other (one per stream).  Failed writes are remembered
+   and reported by vobsub_out_close. */
 typedef struct {
     FILE *fsub;
     FILE *fidx;
     unsigned int aid;
+    int error;
+    double last_pts;
+    int last_pts_set;
+    unsigned int last_h, last_m, last_s, last_ms;
+    unsigned char last_pes_pts[5];
 } vobsub_out_t;
 
 static void create_idx(vobsub_out_t *me, const unsigned int *palette,
@@ -1257,12 +1433,12 @@ static void create_idx(vobsub_out_t *me, const unsigned int *palette,
     fprintf(me->fidx,
             "# VobSub index file, v7 (do not modify this line!)\n"
             "#\n"
-            "# Generated by %s\n"
+            "# Generated by vobsub2srt\n"
             "# See <URL:http://www.mplayerhq.hu/> for more information about MPlayer\n"
             "# See <URL:http://wiki.multimedia.cx/index.php?title=VOBsub> for more information about Vobsub\n"
             "#\n"
             "size: %ux%u\n",
-            mplayer_version, orig_width, orig_height);
+            orig_width, orig_height);
     if (palette) {
         fputs("palette:", me->fidx);
         for (i = 0; i < 16; ++i) {
@@ -1291,14 +1467,17 @@ void *vobsub_out_open(const char *basename, const unsigned int *palette,
     char *filename;
     filename = malloc(strlen(basename) + 5);
     if (filename) {
-        result = malloc(sizeof(vobsub_out_t));
+        result = calloc(1, sizeof(vobsub_out_t));
         if (result) {
             result->aid = index;
+            result->last_h = result->last_m = result->last_s = result->last_ms = 9999;
             strcpy(filename, basename);
             strcat(filename, ".sub");
             result->fsub = fopen(filename, "ab");
-            if (result->fsub == NULL)
+            if (result->fsub == NULL) {
                 perror("Error: vobsub_out_open subtitle file open failed");
+                result->error = 1;
+            }
             strcpy(filename, basename);
             strcat(filename, ".idx");
             result->fidx = fopen(filename, "ab");
@@ -1311,29 +1490,31 @@ void *vobsub_out_open(const char *basename, const unsigned int *palette,
                 fprintf(result->fidx, "\nid: %s, index: %u\n", id ? id : "xx", index);
                 /* So that we can check the file now */
                 fflush(result->fidx);
-            } else
+            } else {
                 perror("Error: vobsub_out_open index file open failed");
-            free(filename);
+                result->error = 1;
+            }
         }
+        free(filename);
     }
     return result;
 }
 
-void vobsub_out_close(void *me)
+int vobsub_out_close(void *me)
 {
     vobsub_out_t *vob = me;
-    if (vob->fidx)
-        fclose(vob->fidx);
-    if (vob->fsub)
-        fclose(vob->fsub);
+    int error = vob->error;
+    if (vob->fidx && fclose(vob->fidx))
+        error = 1;
+    if (vob->fsub && fclose(vob->fsub))
+        error = 1;
     free(vob);
+    return error ? -1 : 0;
 }
 
 void vobsub_out_output(void *me, const unsigned char *packet,
                        int len, double pts)
 {
-    static double last_pts;
-    static int last_pts_set = 0;
     vobsub_out_t *vob = me;
     if (vob->fsub) {
         /*  Windows' Vobsub require that every packet is exactly 2kB long */
@@ -1342,8 +1523,7 @@ void vobsub_out_output(void *me, const unsigned char *packet,
         int remain = 2048;
         /* Do not output twice a line with the same timestamp, this
            breaks Windows' Vobsub */
-        if (vob->fidx && (!last_pts_set || last_pts != pts)) {
-            static unsigned int last_h = 9999, last_m = 9999, last_s = 9999, last_ms = 9999;
+        if (vob->fidx && (!vob->last_pts_set || vob->last_pts != pts)) {
             unsigned int h, m, ms;
             double s;
             s = pts;
@@ -1354,17 +1534,18 @@ void vobsub_out_output(void *me, const unsigned char *packet,
             ms = (s - (unsigned int) s) * 1000;
             if (ms >= 1000)     /* prevent overflows or bad float stuff */
                 ms = 0;
-            if (h != last_h || m != last_m || (unsigned int) s != last_s || ms != last_ms) {
-                fprintf(vob->fidx, "timestamp: %02u:%02u:%02u:%03u, filepos: %09lx\n",
-                        h, m, (unsigned int) s, ms, ftell(vob->fsub));
-                last_h = h;
-                last_m = m;
-                last_s = (unsigned int) s;
-                last_ms = ms;
+            if (h != vob->last_h || m != vob->last_m || (unsigned int) s != vob->last_s || ms != vob->last_ms) {
+                if (fprintf(vob->fidx, "timestamp: %02u:%02u:%02u:%03u, filepos: %09lx\n",
+                            h, m, (unsigned int) s, ms, ftell(vob->fsub)) < 0)
+                    vob->error = 1;
+                vob->last_h = h;
+                vob->last_m = m;
+                vob->last_s = (unsigned int) s;
+                vob->last_ms = ms;
             }
         }
-        last_pts = pts;
-        last_pts_set = 1;
+        vob->last_pts = pts;
+        vob->last_pts_set = 1;
 
         /* Packet start code: Windows' Vobsub needs this */
         p = buffer;
@@ -1376,7 +1557,6 @@ void vobsub_out_output(void *me, const unsigned char *packet,
         memset(p, 0, 9);
         p += 9;
         {   /* Packet */
-            static unsigned char last_pts[5] = { 0, 0, 0, 0, 0};
             unsigned char now_pts[5];
             int pts_len, pad_len, datalen = len;
             pts *= 90000;
@@ -1385,8 +1565,8 @@ void vobsub_out_output(void *me, const unsigned char *packet,
             now_pts[2] = 0x01 | (((unsigned long)pts >> 14) & 0xfe);
             now_pts[3] = ((unsigned long)pts >> 7) & 0xff;
             now_pts[4] = 0x01 | (((unsigned long)pts << 1) & 0xfe);
-            pts_len = memcmp(last_pts, now_pts, sizeof(now_pts)) ? sizeof(now_pts) : 0;
-            memcpy(last_pts, now_pts, sizeof(now_pts));
+            pts_len = memcmp(vob->last_pes_pts, now_pts, sizeof(now_pts)) ? sizeof(now_pts) : 0;
+            memcpy(vob->last_pes_pts, now_pts, sizeof(now_pts));
 
             datalen += 3;       /* Version, PTS_flags, pts_len */
             datalen += pts_len;
@@ -1424,9 +1604,10 @@ void vobsub_out_output(void *me, const unsigned char *packet,
         }
         *p++ = 0x20 |  vob->aid; /* aid */
         if (fwrite(buffer, p - buffer, 1, vob->fsub) != 1
-            || fwrite(packet, len, 1, vob->fsub) != 1)
+            || fwrite(packet, len, 1, vob->fsub) != 1) {
             perror("ERROR: vobsub write failed");
-        else
+            vob->error = 1;
+        } else
             remain -= p - buffer + len;
 
         /* Padding */
@@ -1440,18 +1621,51 @@ void vobsub_out_output(void *me, const unsigned char *packet,
             *p++ = (remain - 6) & 0xff;
             /* for better compression, blank this */
             memset(buffer + 6, 0, remain - (p - buffer));
-            if (fwrite(buffer, remain, 1, vob->fsub) != 1)
+            if (fwrite(buffer, remain, 1, vob->fsub) != 1) {
                 perror("ERROR: vobsub padding write failed");
+                vob->error = 1;
+            }
         } else if (remain > 0) {
             /* I don't know what to output.  But anyway the block
                needs to be 2KB big */
             memset(buffer, 0, remain);
-            if (fwrite(buffer, remain, 1, vob->fsub) != 1)
+            if (fwrite(buffer, remain, 1, vob->fsub) != 1) {
                 perror("ERROR: vobsub blank padding write failed");
-        } else if (remain < 0)
+                vob->error = 1;
+            }
+        } else if (remain < 0) {
             fprintf(stderr,
                     "\nERROR: wrong thing happened...\n"
                     "  I wrote a %i data bytes spu packet and that's too long\n", len);
+            vob->error = 1;
+        }
+    }
+}
+
+/* R: a 2 kB pack holding only a padding packet (vobsub2srt-corpus) */
+void vobsub_out_padding(void *me)
+{
+    vobsub_out_t *vob = me;
+    unsigned char buffer[2048];
+    unsigned char *p = buffer;
+    const unsigned int len = sizeof(buffer) - 14 - 6; /* after the pack and padding headers */
+    if (!vob->fsub)
+        return;
+    memset(buffer, 0, sizeof(buffer));
+    *p++ = 0;                   /* Packet start code */
+    *p++ = 0;
+    *p++ = 1;
+    *p++ = 0xba;
+    *p++ = 0x40;
+    p += 9;
+    *p++ = 0;                   /* Padding */
+    *p++ = 0;
+    *p++ = 1;
+    *p++ = 0xbe;
+    *p++ = len >> 8;
+    *p = len & 0xff;
+    if (fwrite(buffer, sizeof(buffer), 1, vob->fsub) != 1) {
+        perror("ERROR: vobsub padding write failed");
+        vob->error = 1;
     }
 }
-#endif
@@ -19,18 +19,57 @@
 #ifndef MPLAYER_VOBSUB_H
 #define MPLAYER_VOBSUB_H
 
+#include <stddef.h> // R: vobsub_open_memory
+#include <stdint.h> // R: vobsub_stats_t
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-extern int vobsub_id; // R: moved from mpcommon.h
+/* R: The selected stream used to be the global vobsub_id.  It is now part of
+ * the handle.  Different handles can be used concurrently.  One handle can be
+ * used concurrently by several threads as long as each thread reads its own
+ * stream with vobsub_get_next_packet_stream and decodes it with its own
+ * spudec handle (see vobsub_spudec_new).
+ */
 
 void *vobsub_open(const char *subname, const char *const ifo, const int force, unsigned int y_threshold, void** spu);
+/// R: vobsub_open on a .idx and .sub already in memory (no .ifo), e.g. for benchmarks
+void *vobsub_open_memory(const char *idx, size_t idx_len, const unsigned char *sub, size_t sub_len, unsigned int y_threshold, void **spu);
 void vobsub_reset(void *vob);
 int vobsub_parse_ifo(void* self, const char *const name, unsigned int *palette, unsigned int *width, unsigned int *height, int force, int sid, char *langid);
 int vobsub_get_packet(void *vobhandle, float pts,void** data, int* timestamp);
 int vobsub_get_next_packet(void *vobhandle, void** data, int* timestamp);
+/// Like vobsub_get_next_packet but reads from the given stream id instead of the selected one.
+int vobsub_get_next_packet_stream(void *vobhandle, int stream, void** data, int* timestamp);
+/// Get the selected stream id (-1 if none).
+int vobsub_get_stream(void *vobhandle);
+/// Select the stream id used by vobsub_get_packet/vobsub_get_next_packet/vobsub_seek.
+void vobsub_set_stream(void *vobhandle, int stream);
+/// Rewind a single stream.
+void vobsub_reset_stream(void *vobhandle, int stream);
+/// Create a new spudec handle with the palette and settings of the .idx/.ifo.
+void *vobsub_spudec_new(void *vobhandle, unsigned int y_threshold);
+struct spudec_subtitle;
+/**
+ * R: Decode all subtitles of a stream with the given spudec handle.  The
+ * stream is rewound first and fragmented packets are reassembled.  Stores an
+ * array in *subs (free it with spudec_free_subtitles) and returns the number
+ * of subtitles, or -1 on failure.
+ */
+int vobsub_decode_stream(void *vobhandle, void *spu, int stream,
+                         struct spudec_subtitle **subs);
 void vobsub_close(void *self);
+/// R: what vobsub_open read and how long it took (CLOCK_MONOTONIC), see vobsub_get_stats
+typedef struct {
+  unsigned long idx_lines;      ///< lines of the .idx
+  unsigned long mpeg_packets;   ///< MPEG packets read by mpeg_run
+  unsigned long spu_packets;    ///< subtitle packets stored (all streams)
+  uint64_t sub_bytes;           ///< bytes of the .sub read
+  uint64_t idx_ns;              ///< parsing the .idx
+  uint64_t mpeg_run_ns;         ///< demultiplexing the .sub (mpeg_run)
+} vobsub_stats_t;
+void vobsub_get_stats(void *vobhandle, vobsub_stats_t *stats);
 unsigned int vobsub_get_indexes_count(void * /* vobhandle */);
 char *vobsub_get_id(void * /* vobhandle */, unsigned int /* index */);
 
@@ -44,11 +83,19 @@ unsigned int vobsub_palette_to_yuv(unsigned int pal);
 /// Convert rgb value to yuv.
 unsigned int vobsub_rgb_to_yuv(unsigned int rgb);
 
-#if 0 // R: no output needed
+/**
+ * R: VobSub output, used by the corpus generator.  vobsub_out_open appends
+ * a stream to <basename>.idx/.sub (the .idx header is written if the file is
+ * empty), vobsub_out_output writes one SPU fragment of at most 2019 bytes as
+ * a 2 kB pack (pts in seconds, the first fragment with a new pts gets a
+ * timestamp line in the .idx).  vobsub_out_close returns -1 if anything
+ * could not be written.
+ */
 void *vobsub_out_open(const char *basename, const unsigned int *palette, unsigned int orig_width, unsigned int orig_height, const char *id, unsigned int index);
 void vobsub_out_output(void *me, const unsigned char *packet, int len, double pts);
-void vobsub_out_close(void *me);
-#endif
+/// R: writes a 2 kB pack that only holds padding
+void vobsub_out_padding(void *me);
+int vobsub_out_close(void *me);
 int vobsub_set_from_lang(void *vobhandle, char const *lang); // R: changed lang from unsigned char*
 void vobsub_seek(void * vobhandle, float pts);
 
@@ -0,0 +1,533 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmarks for vobsub2srt.  Every benchmark runs for a fixed time and
+ * reports the time per operation and, if it processes data, the throughput.
+ *
+ *   vobsub2srt-bench [filter]
+ *
+ * runs the benchmarks whose name contains filter (all by default).
+ *
+ * The decoder benchmarks use a synthetic .idx/.sub: two lines of text-like
+ * glyphs, RLE encoded into SPU packets and multiplexed into 2048 byte MPEG-2
+ * packs.  The data is the same on every run.
+ */
+
+#include "subtitle_writer.h++"
+#include "stats.h++"
+#include "spu_encoder.h++"
+#include "ocr_preprocess.h++"
+#include "spudec_simd.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+double const min_time = 0.5; ///< seconds per benchmark
+
+/// Prevents the compiler from dropping a computation
+volatile size_t sink;
+
+/**
+ * A benchmark: run(n) does n steps.  The other functions are called after
+ * the last run, outside of the measurement: operations(n) is the number of
+ * operations done by n steps (usually n), bytes(n) the number of bytes
+ * processed (0 if there is no meaningful throughput) and elapsed(wall) the
+ * time to report.  Benchmarks of code inside the decoder report the time
+ * measured by the decoder statistics instead of the wall time of run.
+ */
+struct benchmark {
+  explicit benchmark(char const *name) : name(name) { }
+  virtual ~benchmark() { }
+  virtual void run(size_t n) = 0;
+  virtual size_t operations(size_t n) { return n; }
+  virtual size_t bytes(size_t) { return 0; }
+  virtual double elapsed(double wall) { return wall; }
+  char const *name;
+};
+
+/// Runs b with a growing number of steps until it takes min_time and prints the result
+void measure(benchmark &b) {
+  b.run(1); // warm up
+  size_t n = 1;
+  double wall = 0;
+  for(;;) {
+    double const start = seconds();
+    b.run(n);
+    wall = seconds() - start;
+    if(wall >= min_time or n >= (size_t(1) << 40)) {
+      break;
+    }
+    n = wall < min_time / 100 ? n * 10 : size_t(n * (min_time * 1.2 / wall)) + 1;
+  }
+  size_t const operations = b.operations(n);
+  double const elapsed = b.elapsed(wall);
+  printf("%-32s %12lu %12.1f", b.name, static_cast<unsigned long>(operations), elapsed * 1e9 / operations);
+  size_t const bytes = b.bytes(n);
+  if(bytes) {
+    printf(" %12.1f", bytes / elapsed / (1024 * 1024));
+  }
+  printf("\n");
+}
+
+/// Cues of typical length for the output benchmarks
+struct cue_texts {
+  cue_texts() {
+    static char const *const lines[] = {
+      "I don't think so.", "Where were you last night?\nAt home, I swear!",
+      "- Come on!\n- Wait for me.", "That's all there is to it."
+    };
+    for(size_t i = 0; i < sizeof(lines)/sizeof(lines[0]); ++i) {
+      text.push_back(lines[i]);
+    }
+  }
+  vector<string> text;
+} const cues;
+
+/// The cue at index i: 2 s on, 1 s off
+unsigned cue_start(size_t i) {
+  return unsigned(i % 10000) * 3 * 90000;
+}
+
+/// Size of the first n srt cues
+size_t srt_bytes(size_t n) {
+  size_t bytes = 0;
+  for(size_t i = 0; i < n; ++i) {
+    for(size_t number = i+1; number; number /= 10) {
+      ++bytes;
+    }
+    bytes += sizeof("\nHH:MM:SS,mmm --> HH:MM:SS,mmm\n\n\n") - 1 + cues.text[i % cues.text.size()].size();
+  }
+  return bytes;
+}
+
+/// pts2srt as it was before the output buffer: snprintf into a std::string
+std::string pts2srt_snprintf(unsigned pts) {
+  unsigned ms = pts/90;
+  unsigned const h = ms / (3600 * 1000);
+  ms -= h * 3600 * 1000;
+  unsigned const m = ms / (60 * 1000);
+  ms -= m * 60 * 1000;
+  unsigned const s = ms / 1000;
+  ms %= 1000;
+
+  enum { length = sizeof("HH:MM:SS,MSS") };
+  char buf[length];
+  snprintf(buf, length, "%02d:%02d:%02d,%03d", h, m, s, ms);
+  return std::string(buf);
+}
+
+struct pts2srt_snprintf_bench : public benchmark {
+  pts2srt_snprintf_bench() : benchmark("pts2srt/snprintf") { }
+  void run(size_t n) {
+    size_t sum = 0;
+    for(size_t i = 0; i < n; ++i) {
+      sum += pts2srt_snprintf(cue_start(i) + unsigned(i))[10];
+    }
+    sink = sum;
+  }
+  size_t bytes(size_t n) { return n * timestamp_length; }
+};
+
+struct format_timestamp_bench : public benchmark {
+  format_timestamp_bench() : benchmark("pts2srt/format_timestamp") { }
+  void run(size_t n) {
+    char buf[timestamp_length];
+    size_t sum = 0;
+    for(size_t i = 0; i < n; ++i) {
+      format_timestamp(buf, cue_start(i) + unsigned(i), ',');
+      sum += buf[10];
+    }
+    sink = sum;
+  }
+  size_t bytes(size_t n) { return n * timestamp_length; }
+};
+
+/// Writes srt cues to /dev/null with one fprintf per cue (the old output path)
+struct srt_fprintf_bench : public benchmark {
+  srt_fprintf_bench() : benchmark("srt/fprintf"), out(fopen("/dev/null", "w")) { }
+  ~srt_fprintf_bench() { fclose(out); }
+  void run(size_t n) {
+    for(size_t i = 0; i < n; ++i) {
+      fprintf(out, "%u\n%s --> %s\n%s\n\n", unsigned(i+1), pts2srt_snprintf(cue_start(i)).c_str(),
+              pts2srt_snprintf(cue_start(i) + 2 * 90000).c_str(), cues.text[i % cues.text.size()].c_str());
+    }
+    fflush(out);
+  }
+  size_t bytes(size_t n) { return srt_bytes(n); }
+  FILE *out;
+};
+
+/// Writes srt cues to /dev/null through the srt writer and the output buffer
+struct srt_buffer_bench : public benchmark {
+  srt_buffer_bench() : benchmark("srt/output_buffer"), out(fopen("/dev/null", "w")) { }
+  ~srt_buffer_bench() { fclose(out); }
+  void run(size_t n) {
+    {
+      output_buffer buffer(out);
+      subtitle_writer *writer = create_subtitle_writer("srt", buffer);
+      for(size_t i = 0; i < n; ++i) {
+        writer->write(unsigned(i+1), cue_start(i), cue_start(i) + 2 * 90000, cues.text[i % cues.text.size()]);
+      }
+      delete writer;
+    }
+    fflush(out);
+  }
+  size_t bytes(size_t n) { return srt_bytes(n); }
+  FILE *out;
+};
+
+/// Two lines of random glyphs in 600x72 pixels, the size of a typical subtitle
+spu_bitmap subtitle_image(unsigned seed) {
+  spu_bitmap image(600, 72);
+  render_glyphs(image, 2, seed);
+  return image;
+}
+
+/**
+ * Appends the SPU packet as 2048 byte MPEG-2 packs of subtitle stream 0 to
+ * sub, the first one with the PTS, and the payload of each pack to
+ * fragments.  Returns the number of packs.
+ */
+size_t append_packs(vector<unsigned char> &sub, vector< vector<unsigned char> > &fragments,
+                    vector<unsigned char> const &spu, unsigned pts) {
+  enum { pack_size = 2048, pack_header = 14, pes_header = 6, padding_header = 6 };
+  size_t packs = 0;
+  for(size_t offset = 0; offset < spu.size(); ++packs) {
+    size_t const start = sub.size();
+    unsigned char const pack[pack_header] = { 0, 0, 1, 0xba, 0x44 };
+    sub.insert(sub.end(), pack, pack + pack_header);
+
+    unsigned const pts_length = offset == 0 ? 5 : 0;
+    size_t const room = pack_size - pack_header - pes_header - 3 - pts_length - 1 - padding_header;
+    size_t const payload = spu.size() - offset < room ? spu.size() - offset : room;
+    unsigned const length = 3 + pts_length + 1 + payload;
+    unsigned char const pes[] = {
+      0, 0, 1, 0xbd, static_cast<unsigned char>(length >> 8), static_cast<unsigned char>(length & 0xff),
+      0x81, static_cast<unsigned char>(pts_length ? 0x80 : 0), static_cast<unsigned char>(pts_length),
+      static_cast<unsigned char>(0x21 | ((pts >> 29) & 0x0e)), static_cast<unsigned char>((pts >> 22) & 0xff),
+      static_cast<unsigned char>(0x01 | ((pts >> 14) & 0xfe)), static_cast<unsigned char>((pts >> 7) & 0xff),
+      static_cast<unsigned char>(0x01 | ((pts << 1) & 0xfe))
+    };
+    sub.insert(sub.end(), pes, pes + 9 + pts_length);
+    sub.push_back(0x20); // stream 0
+    sub.insert(sub.end(), spu.begin() + offset, spu.begin() + offset + payload);
+    fragments.push_back(vector<unsigned char>(spu.begin() + offset, spu.begin() + offset + payload));
+    offset += payload;
+
+    unsigned const padding = pack_size - (sub.size() - start) - padding_header;
+    unsigned char const pad[padding_header] = {
+      0, 0, 1, 0xbe, static_cast<unsigned char>(padding >> 8), static_cast<unsigned char>(padding & 0xff)
+    };
+    sub.insert(sub.end(), pad, pad + padding_header);
+    sub.insert(sub.end(), padding, 0xff);
+  }
+  return packs;
+}
+
+/// Global palette of the synthetic subtitles (YUV): transparent, white text, black outline
+unsigned int palette[16] = { 0x108080, 0xeb8080, 0x108080, 0x808080 };
+/// The same as MPlayer-style gray/alpha pairs for pal2gray_alpha: alpha is stored negated
+uint16_t const gray_alpha[4] = { 0x0000, 0x01eb, 0x0110, 0x0180 };
+
+char const idx_header[] =
+  "# VobSub index file, v7 (do not modify this line!)\n"
+  "size: 720x576\n"
+  "palette: 000000, ffffff, 000000, 808080, 000000, 000000, 000000, 000000, "
+  "000000, 000000, 000000, 000000, 000000, 000000, 000000, 000000\n"
+  "forced subs: OFF\n"
+  "langidx: 0\n"
+  "id: en, index: 0\n";
+
+/// The synthetic stream: count subtitles of 600x72 pixels, one every 3 s
+struct subtitle_stream {
+  explicit subtitle_stream(unsigned count) : packs(0), idx(idx_header) {
+    for(unsigned i = 0; i < count; ++i) {
+      vector<unsigned char> spu;
+      encode_spu(subtitle_image(i + 1), 60, 480, 2 * 90000, spu);
+      unsigned const pts = (i + 1) * 3 * 90000;
+      char line[64];
+      snprintf(line, sizeof(line), "timestamp: %02u:%02u:%02u:%03u, filepos: %09lx\n",
+               pts / 90000 / 3600, pts / 90000 / 60 % 60, pts / 90000 % 60, pts / 90 % 1000,
+               static_cast<unsigned long>(sub.size()));
+      idx += line;
+      first_fragment.push_back(fragments.size());
+      subtitle_pts.push_back(pts);
+      packs += append_packs(sub, fragments, spu, pts);
+    }
+    first_fragment.push_back(fragments.size());
+  }
+  size_t packs;
+  string idx;
+  vector<unsigned char> sub;
+  vector< vector<unsigned char> > fragments;
+  vector<size_t> first_fragment; ///< of each subtitle, and the end
+  vector<unsigned> subtitle_pts; ///< PTS of each subtitle
+};
+
+subtitle_stream const &stream() {
+  static subtitle_stream const s(100);
+  return s;
+}
+
+/// mpeg_run: vobsub_open_memory of the .sub, an operation is one MPEG pack
+struct mpeg_run_bench : public benchmark {
+  mpeg_run_bench() : benchmark("mpeg_run") { }
+  void run(size_t n) {
+    memset(&total, 0, sizeof(total));
+    for(size_t i = 0; i < n; ++i) {
+      void *const vob = vobsub_open_memory(idx_header, sizeof(idx_header) - 1,
+                                           &stream().sub[0], stream().sub.size(), 0, 0x0);
+      vobsub_stats_t stats;
+      vobsub_get_stats(vob, &stats);
+      total.mpeg_packets += stats.mpeg_packets;
+      total.sub_bytes += stats.sub_bytes;
+      total.mpeg_run_ns += stats.mpeg_run_ns;
+      vobsub_close(vob);
+    }
+  }
+  size_t operations(size_t) { return total.mpeg_packets; }
+  size_t bytes(size_t) { return total.sub_bytes; }
+  double elapsed(double) { return total.mpeg_run_ns * 1e-9; }
+  vobsub_stats_t total;
+};
+
+/// vobsub_parse_one_line: vobsub_open_memory of the .idx, an operation is one line
+struct parse_idx_bench : public benchmark {
+  parse_idx_bench() : benchmark("vobsub_parse_one_line") { }
+  void run(size_t n) {
+    memset(&total, 0, sizeof(total));
+    for(size_t i = 0; i < n; ++i) {
+      void *const vob = vobsub_open_memory(stream().idx.data(), stream().idx.size(), 0x0, 0, 0, 0x0);
+      vobsub_stats_t stats;
+      vobsub_get_stats(vob, &stats);
+      total.idx_lines += stats.idx_lines;
+      total.idx_ns += stats.idx_ns;
+      vobsub_close(vob);
+    }
+  }
+  size_t operations(size_t) { return total.idx_lines; }
+  size_t bytes(size_t n) { return n * stream().idx.size(); }
+  double elapsed(double) { return total.idx_ns * 1e-9; }
+  vobsub_stats_t total;
+};
+
+/// Base of the spudec benchmarks: a decoder with the palette of the stream and its statistics
+struct spudec_bench : public benchmark {
+  explicit spudec_bench(char const *name) : benchmark(name), spu(spudec_new(palette, 0)) {
+    memset(&before, 0, sizeof(before));
+    memset(&after, 0, sizeof(after));
+  }
+  ~spudec_bench() { spudec_free(spu); }
+  /// Feeds the fragments of subtitle i of the stream
+  void assemble(size_t i) {
+    subtitle_stream const &s = stream();
+    for(size_t f = s.first_fragment[i]; f < s.first_fragment[i+1]; ++f) {
+      spudec_assemble(spu, const_cast<unsigned char*>(&s.fragments[f][0]), s.fragments[f].size(), s.subtitle_pts[i]);
+    }
+  }
+  void *spu;
+  spudec_decode_stats_t before, after;
+
+private:
+  // noncopyable
+  spudec_bench(spudec_bench const&);
+  spudec_bench &operator=(spudec_bench const&);
+};
+
+/// spudec_assemble: an operation is one fragment (the payload of a pack)
+struct assemble_bench : public spudec_bench {
+  assemble_bench() : spudec_bench("spudec_assemble") { }
+  void run(size_t n) {
+    subtitle_stream const &s = stream();
+    spudec_get_decode_stats(spu, &before);
+    for(size_t i = 0, f = 0; i < n; ++i, ++f) {
+      if(f == s.fragments.size()) { // drop the decoded packets
+        spudec_reset(spu);
+        f = 0;
+      }
+      size_t const subtitle = upper_bound(s.first_fragment.begin(), s.first_fragment.end(), f) - s.first_fragment.begin() - 1;
+      spudec_assemble(spu, const_cast<unsigned char*>(&s.fragments[f][0]), s.fragments[f].size(), s.subtitle_pts[subtitle]);
+    }
+    spudec_get_decode_stats(spu, &after);
+    spudec_reset(spu);
+  }
+  size_t bytes(size_t) { return after.fragment_bytes - before.fragment_bytes; }
+  double elapsed(double) { return (after.assemble_ns - before.assemble_ns) * 1e-9; }
+};
+
+/**
+ * spudec_process_data (RLE decoding, palette and cropping of one image),
+ * called by spudec_heartbeat.  Each subtitle queues two display commands, an
+ * operation is one image.  The throughput is in pixels.
+ */
+struct process_data_bench : public spudec_bench {
+  process_data_bench() : spudec_bench("spudec_process_data") { }
+  void run(size_t n) {
+    spudec_simd_select(spudec_simd_detect());
+    spudec_get_decode_stats(spu, &before);
+    for(size_t i = 0; i < n; ++i) {
+      assemble(i % (stream().first_fragment.size() - 1));
+      spudec_heartbeat(spu, UINT_MAX);
+    }
+    spudec_get_decode_stats(spu, &after);
+  }
+  size_t operations(size_t) { return after.images - before.images; }
+  size_t bytes(size_t) { return after.pixels - before.pixels; }
+  double elapsed(double) { return (after.process_ns - before.process_ns) * 1e-9; }
+};
+
+/// A benchmark for each instruction set level of the SIMD kernels
+struct simd_bench : public benchmark {
+  simd_bench(char const *function, int level)
+    : benchmark(""), level(level), label(string(function) + "/" + spudec_simd_name(level))
+  {
+    name = label.c_str();
+  }
+  int level;
+  string label;
+};
+
+/// pal2gray_alpha4 on the index image of a subtitle, an operation is one image
+struct pal2gray_alpha_bench : public simd_bench {
+  explicit pal2gray_alpha_bench(int level)
+    : simd_bench("pal2gray_alpha", level), image(subtitle_image(1)), stride((image.width + 7) & ~7u),
+      planes(2 * stride * image.height)
+  { }
+  void run(size_t n) {
+    spudec_simd_select(level);
+    for(size_t i = 0; i < n; ++i) {
+      pal2gray_alpha4(gray_alpha, &image.pixels[0], image.width, &planes[0], &planes[stride * image.height],
+                      stride, image.width, image.height);
+    }
+    sink = planes[stride * image.height / 2];
+  }
+  size_t bytes(size_t n) { return n * image.pixels.size(); }
+  spu_bitmap const image;
+  unsigned const stride;
+  vector<unsigned char> planes;
+};
+
+/**
+ * spudec_cut_image: the bounding box (spudec_find_bbox) of a subtitle at the
+ * bottom of a 720x576 alpha plane, an operation is one image
+ */
+struct cut_image_bench : public simd_bench {
+  explicit cut_image_bench(int level) : simd_bench("spudec_cut_image", level), plane(width * height) {
+    spu_bitmap const image = subtitle_image(1);
+    for(unsigned y = 0; y < image.height; ++y) {
+      for(unsigned x = 0; x < image.width; ++x) {
+        plane[(480 + y) * width + 60 + x] = image.pixels[y * image.width + x] ? 0xff : 0;
+      }
+    }
+  }
+  void run(size_t n) {
+    spudec_simd_select(level);
+    size_t sum = 0;
+    for(size_t i = 0; i < n; ++i) {
+      int x0, y0, x1, y1;
+      spudec_find_bbox(&plane[0], width, width, height, &x0, &y0, &x1, &y1);
+      sum += x0 + y0 + x1 + y1;
+    }
+    sink = sum;
+  }
+  size_t bytes(size_t n) { return n * plane.size(); }
+  enum { width = 720, height = 576 };
+  vector<unsigned char> plane;
+};
+
+/**
+ * ocr_preprocessor::process (--ocr-scale and --binarize) on a gray 600x36
+ * text line, an operation is one line.  The upscaling is scalar, the
+ * binarization uses the SIMD level.
+ */
+struct ocr_preprocess_bench : public simd_bench {
+  ocr_preprocess_bench(int level, unsigned scale)
+    : simd_bench("ocr_preprocess", level), preprocessor(scale, true), line(600, 36)
+  {
+    if(scale > 1) {
+      char suffix[16];
+      snprintf(suffix, sizeof(suffix), "/x%u", scale);
+      label += suffix;
+      name = label.c_str();
+    }
+    render_glyphs(line, 1, 1);
+    static unsigned char const gray[4] = { 0x00, 0xeb, 0x10, 0x80 }; // the palette of the stream
+    for(size_t i = 0; i < line.pixels.size(); ++i) {
+      line.pixels[i] = gray[line.pixels[i]];
+    }
+  }
+  void run(size_t n) {
+    spudec_simd_select(level);
+    for(size_t i = 0; i < n; ++i) {
+      sink = *preprocessor.process(&line.pixels[0], line.width, line.height, line.width);
+    }
+  }
+  size_t bytes(size_t n) { return n * line.pixels.size(); }
+  ocr_preprocessor preprocessor;
+  spu_bitmap line;
+};
+}
+
+int main(int argc, char **argv) {
+  char const *const filter = argc > 1 ? argv[1] : "";
+
+  vector<benchmark*> benchmarks;
+  benchmarks.push_back(new mpeg_run_bench);
+  benchmarks.push_back(new parse_idx_bench);
+  benchmarks.push_back(new assemble_bench);
+  benchmarks.push_back(new process_data_bench);
+  for(int level = SPUDEC_SIMD_NONE; level <= SPUDEC_SIMD_NEON; ++level) {
+    if(spudec_simd_select(level) == level) {
+      benchmarks.push_back(new pal2gray_alpha_bench(level));
+    }
+  }
+  for(int level = SPUDEC_SIMD_NONE; level <= SPUDEC_SIMD_NEON; ++level) {
+    if(spudec_simd_select(level) == level) {
+      benchmarks.push_back(new cut_image_bench(level));
+    }
+  }
+  for(unsigned scale = 1; scale <= 4; scale *= 2) {
+    for(int level = SPUDEC_SIMD_NONE; level <= SPUDEC_SIMD_NEON; ++level) {
+      if(spudec_simd_select(level) == level) {
+        benchmarks.push_back(new ocr_preprocess_bench(level, scale));
+      }
+    }
+  }
+  spudec_simd_select(spudec_simd_detect());
+  benchmarks.push_back(new pts2srt_snprintf_bench);
+  benchmarks.push_back(new format_timestamp_bench);
+  benchmarks.push_back(new srt_fprintf_bench);
+  benchmarks.push_back(new srt_buffer_bench);
+
+  printf("%-32s %12s %12s %12s\n", "benchmark", "operations", "ns/op", "MiB/s");
+  for(size_t i = 0; i < benchmarks.size(); ++i) {
+    if(strstr(benchmarks[i]->name, filter)) {
+      measure(*benchmarks[i]);
+    }
+    delete benchmarks[i];
+  }
+}
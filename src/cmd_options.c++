@@ -27,11 +27,12 @@ using namespace std;
 
 namespace {
 struct option {
-  enum arg_type { Bool, String, Int } type;
+  enum arg_type { Bool, String, Int, StringList } type;
   union {
     bool *flag;
     std::string *str;
     int *i;
+    std::vector<std::string> *list;
   } ref;
   char const *name;
   char const *description;
@@ -51,6 +52,9 @@ struct option {
     case Int:
       ref.i = reinterpret_cast<int*>(&r);
       break;
+    case StringList:
+      ref.list = reinterpret_cast<std::vector<std::string>*>(&r);
+      break;
     }
   }
 };
@@ -94,6 +98,11 @@ cmd_options &cmd_options::add_option(char const *name, int &val, char const *des
   return *this;
 }
 
+cmd_options &cmd_options::add_option(char const *name, std::vector<std::string> &val, char const *description, char short_name) {
+  pimpl->options.push_back(option(name, option::StringList, val, description, short_name));
+  return *this;
+}
+
 cmd_options &cmd_options::add_unnamed(std::string &val, char const *help_name, char const *description) {
   pimpl->unnamed_args.push_back(unnamed(val, help_name, description));
   return *this;
@@ -103,7 +112,7 @@ bool cmd_options::parse_cmd(int argc, char **argv) const {
   size_t current_unnamed = 0;
   bool parse_options = true; // set to false after --
   for(int i = 1; i < argc; ++i) {
-    if(parse_options and argv[i][0] == '-') {
+    if(parse_options and argv[i][0] == '-' and argv[i][1] != '\0') {
       unsigned offset = 1;
       if(argv[i][1] == '-') {
         if(argv[i][2] == '\0') {
@@ -126,7 +135,8 @@ bool cmd_options::parse_cmd(int argc, char **argv) const {
             break;
           }
 
-          if(i+1 >= argc or argv[i+1][0] == '-') { // Check if next argv is an option or argument
+          // Check if next argv is an option or argument ("-" alone is an argument, e.g. stdout)
+          if(i+1 >= argc or (argv[i+1][0] == '-' and argv[i+1][1] != '\0')) {
             cerr << "option " << argv[i] << " is missing an argument\n";
             exit = true;
             return false;
@@ -136,6 +146,9 @@ bool cmd_options::parse_cmd(int argc, char **argv) const {
           if(j->type == option::String) {
             *j->ref.str = argv[i];
           }
+          else if(j->type == option::StringList) {
+            j->ref.list->push_back(argv[i]);
+          }
           else if(j->type == option::Int) {
             char *endptr;
             *j->ref.i = strtol(argv[i], &endptr, 10);
@@ -178,7 +191,10 @@ void cmd_options::help(char const *progname) const {
   cerr << "\n\n";
   for(std::vector<option>::const_iterator i = pimpl->options.begin(); i != pimpl->options.end(); ++i) {
     cerr << "\t--" << i->name;
-    if(i->type != option::Bool) {
+    if(i->type == option::StringList) {
+      cerr << " <arg> (repeatable)";
+    }
+    else if(i->type != option::Bool) {
       cerr << " <arg>";
     }
     if(i->short_name != '\0') {
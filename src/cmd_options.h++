@@ -21,6 +21,7 @@
 #define CMD_OPTIONS_HXX
 
 #include <string> // string_fwd in C++0x
+#include <vector>
 
 /// Handle argc/argv
 struct cmd_options {
@@ -30,6 +31,8 @@ struct cmd_options {
   cmd_options &add_option(char const *name, bool &val, char const *description, char short_name = '\0');
   cmd_options &add_option(char const *name, std::string &val, char const *description, char short_name = '\0');
   cmd_options &add_option(char const *name, int &val, char const *description, char short_name = '\0');
+  /// The option can be given several times, each argument is appended to val
+  cmd_options &add_option(char const *name, std::vector<std::string> &val, char const *description, char short_name = '\0');
 
   cmd_options &add_unnamed(std::string &val, char const *help_name, char const *description);
 
@@ -0,0 +1,285 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Generator of synthetic VobSub files for tests and benchmarks.
+ *
+ *   vobsub2srt-corpus [options] <basename>
+ *
+ * writes <basename>.idx/.sub with the given number of streams and cues.  The
+ * subtitles are rendered text (and <basename>-<id>.srt with the text of each
+ * stream, to compare the OCR against) or random glyphs (--glyphs).  The
+ * output is the same for the same options.
+ */
+
+#include "cmd_options.h++"
+#include "spu_encoder.h++"
+#include "subtitle_writer.h++"
+#include "vobsub.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+unsigned const frame_width = 720, frame_height = 576;
+/// Distance of the subtitles from the bottom and the sides of the frame
+unsigned const margin = 40;
+/// Payload of a pack written by vobsub_out_output
+size_t const max_fragment = 2019;
+/// SPU packets store their size in 16 bits
+size_t const max_packet = 0xffff;
+unsigned const duration = 2 * 90000;
+
+/// YUV palette: transparent, white text, black outline
+unsigned int const palette[16] = {
+  0x108080, 0xeb8080, 0x108080, 0x808080, 0x108080, 0x108080, 0x108080, 0x108080,
+  0x108080, 0x108080, 0x108080, 0x108080, 0x108080, 0x108080, 0x108080, 0x108080
+};
+
+char const *const stream_ids[] = {
+  "en", "de", "fr", "es", "it", "nl", "sv", "da", "fi", "no", "pt", "pl", "cs", "hu", "ru", "el",
+  "tr", "ar", "he", "ja", "ko", "zh", "th", "vi", "id", "ms", "hi", "ro", "bg", "hr", "sk", "sl"
+};
+int const max_streams = sizeof(stream_ids) / sizeof(stream_ids[0]);
+
+char const *const default_texts[] = {
+  "The quick brown fox jumps over the lazy dog.",
+  "Pack my box with five dozen liquor jugs!",
+  "How vexingly quick daft zebras jump.|- Really?",
+  "Sphinx of black quartz, judge my vow.",
+  "We have 12 minutes left, 3 seconds... 2... 1...",
+  "\"Where are you going?\"|\"Home.\"",
+  "Jackdaws love my big sphinx of quartz (and 42 others).",
+  "The five boxing wizards jump quickly; then they rest."
+};
+
+/// Splits text at '|' and wraps the lines at spaces to at most columns characters
+vector<string> wrap(string const &text, size_t columns) {
+  vector<string> lines;
+  size_t begin = 0;
+  for(;;) {
+    size_t const end = text.find('|', begin);
+    string rest = text.substr(begin, end == string::npos ? string::npos : end - begin);
+    while(rest.size() > columns) {
+      size_t cut = rest.rfind(' ', columns);
+      if(cut == string::npos or cut == 0) {
+        cut = columns;
+      }
+      lines.push_back(rest.substr(0, cut));
+      rest.erase(0, rest[cut] == ' ' ? cut + 1 : cut);
+    }
+    lines.push_back(rest);
+    if(end == string::npos) {
+      return lines;
+    }
+    begin = end + 1;
+  }
+}
+
+/// The text of the reference .srt: the lines separated by '\n'
+string join(vector<string> const &lines) {
+  string text;
+  for(size_t i = 0; i < lines.size(); ++i) {
+    if(i) {
+      text += '\n';
+    }
+    text += lines[i];
+  }
+  return text;
+}
+
+bool truncate(string const &filename) {
+  FILE *const file = fopen(filename.c_str(), "wb");
+  if(not file) {
+    cerr << "Couldn't create '" << filename << "'\n";
+    return false;
+  }
+  return fclose(file) == 0;
+}
+
+/**
+ * Writes packet in fragments of about equal size, at least fragments of
+ * them.  The decoder rejects fragments shorter than 2 bytes, so there are
+ * at most half as many fragments as bytes.  Returns the number of packs.
+ */
+size_t output_fragments(void *vob, vector<unsigned char> const &packet, size_t fragments, double pts) {
+  size_t const needed = (packet.size() + max_fragment - 1) / max_fragment;
+  size_t const most = packet.size() / 2 > 1 ? packet.size() / 2 : 1;
+  size_t const count = fragments > needed ? (fragments < most ? fragments : most) : needed;
+  // fragment i ends at packet.size()*(i+1)/count, so none is shorter than packet.size()/count
+  for(size_t i = 0; i < count; ++i) {
+    size_t const begin = packet.size() * i / count, end = packet.size() * (i + 1) / count;
+    vobsub_out_output(vob, &packet[begin], static_cast<int>(end - begin), pts);
+  }
+  return count;
+}
+
+/// Writes the text of cue i, shown from start_pts[i], to the .srt filename
+bool write_reference(string const &filename, vector<unsigned> const &start_pts, vector<string> const &text) {
+  FILE *const file = fopen(filename.c_str(), "wb");
+  if(not file) {
+    cerr << "Couldn't create '" << filename << "'\n";
+    return false;
+  }
+  bool ok;
+  {
+    output_buffer out(file);
+    subtitle_writer *const writer = create_subtitle_writer("srt", out);
+    writer->begin();
+    for(size_t i = 0; i < text.size(); ++i) {
+      writer->write(i + 1, start_pts[i], start_pts[i] + spu_duration(duration), text[i]);
+    }
+    writer->end();
+    delete writer;
+    ok = out.flush();
+  }
+  if(fclose(file) != 0 or not ok) {
+    cerr << "Couldn't write '" << filename << "'\n";
+    return false;
+  }
+  return true;
+}
+}
+
+int main(int argc, char **argv) {
+  bool glyphs = false;
+  string basename;
+  string text_file;
+  int cues = 100;
+  int streams = 1;
+  int scale = 3;
+  int glyph_width = 600;
+  int glyph_lines = 2;
+  int fragments = 1;
+  int padding = 0;
+  int seed = 1;
+
+  {
+    cmd_options opts;
+    opts.
+      add_option("cues", cues, "Number of subtitles of each stream (Default: 100)").
+      add_option("streams", streams, "Number of subtitle streams (1-32) (Default: 1)").
+      add_option("text", text_file, "Render the lines of this file, one subtitle per line, '|' starts a new line (Default: built-in sentences)").
+      add_option("scale", scale, "Scale of the 5x7 pixel font (1-8) (Default: 3)").
+      add_option("glyphs", glyphs, "Render random glyphs instead of text").
+      add_option("glyph-width", glyph_width, "Width in pixels of the --glyphs images (Default: 600)").
+      add_option("glyph-lines", glyph_lines, "Lines of the --glyphs images, 36 pixels each (Default: 2)").
+      add_option("fragments", fragments, "Split each subtitle into at least this many packs, at most one per 2 bytes (Default: 1)").
+      add_option("padding", padding, "Number of padding packs after each subtitle (Default: 0)").
+      add_option("seed", seed, "Seed of the random glyphs (Default: 1)").
+      add_unnamed(basename, "basename", "name of the generated files WITHOUT .idx/.sub ending! (REQUIRED)");
+    if(not opts.parse_cmd(argc, argv) or basename.empty()) {
+      return 1;
+    }
+  }
+
+  if(cues < 1 or streams < 1 or streams > max_streams or scale < 1 or scale > 8 or fragments < 1 or padding < 0 or
+     glyph_width < 16 or glyph_width > int(frame_width) or glyph_lines < 1 or glyph_lines > 12) {
+    cerr << "Invalid option value.\n";
+    return 1;
+  }
+
+  vector<string> texts;
+  if(not text_file.empty()) {
+    ifstream in(text_file.c_str());
+    if(not in) {
+      cerr << "Couldn't open '" << text_file << "'\n";
+      return 1;
+    }
+    string line;
+    while(getline(in, line)) {
+      if(not line.empty()) {
+        texts.push_back(line);
+      }
+    }
+    if(texts.empty()) {
+      cerr << "'" << text_file << "' has no text\n";
+      return 1;
+    }
+  }
+  else {
+    texts.assign(default_texts, default_texts + sizeof(default_texts) / sizeof(default_texts[0]));
+  }
+
+  if(not truncate(basename + ".idx") or not truncate(basename + ".sub")) {
+    return 1;
+  }
+
+  size_t const columns = (frame_width - 2 * margin) / (6 * scale);
+  size_t packs = 0;
+  for(int stream = 0; stream < streams; ++stream) {
+    void *const vob = vobsub_out_open(basename.c_str(), palette, frame_width, frame_height,
+                                      stream_ids[stream], stream);
+    if(not vob) {
+      cerr << "Couldn't open '" << basename << ".idx/.sub'\n";
+      return 1;
+    }
+
+    vector<unsigned> start_pts;
+    vector<string> reference;
+    vector<unsigned char> packet;
+    bool fits = true;
+    for(int cue = 0; cue < cues; ++cue) {
+      unsigned const start = (1 + 3 * cue) * 90000;
+      spu_bitmap bitmap;
+      if(glyphs) {
+        bitmap = spu_bitmap(glyph_width, glyph_lines * 36);
+        render_glyphs(bitmap, glyph_lines, seed + stream * cues + cue);
+      }
+      else {
+        vector<string> const lines = wrap(texts[(cue + stream) % texts.size()], columns);
+        bitmap = render_text(lines, scale);
+        start_pts.push_back(start);
+        reference.push_back(join(lines));
+      }
+      if(bitmap.height + margin > frame_height) {
+        cerr << "Subtitle " << cue + 1 << " is too high for the " << frame_width << 'x' << frame_height << " frame\n";
+        fits = false;
+        break;
+      }
+      encode_spu(bitmap, (frame_width - bitmap.width) / 2, frame_height - margin - bitmap.height, duration, packet);
+      if(packet.size() > max_packet) {
+        cerr << "Subtitle " << cue + 1 << " is too large for an SPU packet (" << packet.size() << " bytes)\n";
+        fits = false;
+        break;
+      }
+      packs += output_fragments(vob, packet, fragments, start / 90000.0);
+      for(int i = 0; i < padding; ++i) {
+        vobsub_out_padding(vob);
+      }
+      packs += padding;
+    }
+    if(vobsub_out_close(vob) != 0) {
+      cerr << "Couldn't write '" << basename << ".idx/.sub'\n";
+      return 1;
+    }
+    if(not fits or (not glyphs and not write_reference(basename + "-" + stream_ids[stream] + ".srt", start_pts, reference))) {
+      return 1;
+    }
+  }
+
+  cout << "Wrote " << basename << ".idx/.sub: " << streams << " stream(s) of " << cues << " subtitle(s), "
+       << packs << " packs\n";
+  return 0;
+}
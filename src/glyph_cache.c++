@@ -0,0 +1,439 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "glyph_cache.h++"
+#include "ocr_backend.h++"
+#include "ocr.h++"
+
+#include <pthread.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace {
+/// Symbols below this confidence are not learned
+int const learn_confidence = 75;
+
+/// A glyph of a line (inclusive columns and rows)
+struct glyph {
+  unsigned left, right, top, bottom;
+  int offset; ///< bottom row relative to the baseline of the line
+};
+
+bool glyph_left(glyph const &a, glyph const &b) {
+  return a.left < b.left;
+}
+
+/// A binarized line and its glyphs from left to right
+struct line_glyphs {
+  unsigned width, height;
+  vector<unsigned char> bits;
+  vector<glyph> glyphs;
+};
+
+/// Binarizes a line at half its brightest value and splits it into glyphs.
+void segment(unsigned char const *image, unsigned width, unsigned height, unsigned stride, line_glyphs &line) {
+  line.width = width;
+  line.height = height;
+  line.glyphs.clear();
+  unsigned char max_value = 0;
+  for(unsigned y = 0; y < height; ++y) {
+    unsigned char const *row = image + y*stride;
+    max_value = max(max_value, *max_element(row, row + width));
+  }
+  if(max_value == 0) {
+    return;
+  }
+  unsigned char const threshold = max_value / 2;
+  line.bits.resize(width * height);
+  for(unsigned y = 0; y < height; ++y) {
+    unsigned char const *row = image + y*stride;
+    for(unsigned x = 0; x < width; ++x) {
+      line.bits[y*width + x] = row[x] > threshold;
+    }
+  }
+
+  // connected components (8-connected), visited pixels are marked with 2
+  vector<glyph> components;
+  vector<unsigned> stack;
+  for(unsigned start = 0; start < width * height; ++start) {
+    if(line.bits[start] != 1) {
+      continue;
+    }
+    glyph c;
+    c.left = c.right = start % width;
+    c.top = c.bottom = start / width;
+    line.bits[start] = 2;
+    stack.push_back(start);
+    while(not stack.empty()) {
+      unsigned const x = stack.back() % width, y = stack.back() / width;
+      stack.pop_back();
+      c.left = min(c.left, x);
+      c.right = max(c.right, x);
+      c.top = min(c.top, y);
+      c.bottom = max(c.bottom, y);
+      for(unsigned ny = y > 0 ? y - 1 : 0; ny <= y + 1 and ny < height; ++ny) {
+        for(unsigned nx = x > 0 ? x - 1 : 0; nx <= x + 1 and nx < width; ++nx) {
+          if(line.bits[ny*width + nx] == 1) {
+            line.bits[ny*width + nx] = 2;
+            stack.push_back(ny*width + nx);
+          }
+        }
+      }
+    }
+    components.push_back(c);
+  }
+  for(size_t i = 0; i < line.bits.size(); ++i) {
+    line.bits[i] = line.bits[i] != 0;
+  }
+
+  // merge components overlapping horizontally (e.g. i and its dot)
+  sort(components.begin(), components.end(), glyph_left);
+  for(size_t i = 0; i < components.size(); ++i) {
+    glyph const &c = components[i];
+    if(not line.glyphs.empty() and c.left <= line.glyphs.back().right) {
+      glyph &g = line.glyphs.back();
+      g.right = max(g.right, c.right);
+      g.top = min(g.top, c.top);
+      g.bottom = max(g.bottom, c.bottom);
+    }
+    else {
+      line.glyphs.push_back(c);
+    }
+  }
+
+  // the baseline is the most common bottom row (tells apart e.g. ' and ,)
+  vector<unsigned> bottoms(height);
+  for(size_t i = 0; i < line.glyphs.size(); ++i) {
+    ++bottoms[line.glyphs[i].bottom];
+  }
+  int const baseline = max_element(bottoms.begin(), bottoms.end()) - bottoms.begin();
+  for(size_t i = 0; i < line.glyphs.size(); ++i) {
+    line.glyphs[i].offset = static_cast<int>(line.glyphs[i].bottom) - baseline;
+  }
+}
+
+unsigned long glyph_key(glyph const &g) {
+  int const offset = max(-127, min(127, g.offset)) + 128;
+  return (static_cast<unsigned long>(g.right - g.left + 1) & 0xfff) << 20 |
+    ((g.bottom - g.top + 1) & 0xfff) << 8 | offset;
+}
+
+/// A learned glyph
+struct glyph_entry {
+  glyph_entry() : ink(0), text_votes(0), total_votes(0), confidence_sum(0) { }
+  vector<unsigned char> bits; ///< binarized pixels (size from the key)
+  unsigned ink;
+  map<string, unsigned> votes; ///< text seen by the engine
+  string text; ///< text with the most votes
+  unsigned text_votes, total_votes;
+  long confidence_sum;
+
+  /// The engine disagrees too often (e.g. l and I look the same in many fonts)
+  bool ambiguous() const {
+    return text_votes * 10 < total_votes * 9;
+  }
+  int confidence() const {
+    return confidence_sum / static_cast<long>(total_votes);
+  }
+};
+
+/// Counts the pixels of g in line that differ from entry
+unsigned difference(line_glyphs const &line, glyph const &g, glyph_entry const &entry) {
+  unsigned const width = g.right - g.left + 1;
+  unsigned diff = 0;
+  for(unsigned y = g.top; y <= g.bottom; ++y) {
+    unsigned char const *row = &line.bits[y*line.width + g.left];
+    unsigned char const *learned = &entry.bits[(y - g.top) * width];
+    for(unsigned x = 0; x < width; ++x) {
+      diff += row[x] != learned[x];
+    }
+  }
+  return diff;
+}
+}
+
+struct glyph_cache::impl {
+  impl() : count(0), max_letter_gap(-1), min_word_gap(-1), hits(0), misses(0) {
+    pthread_rwlock_init(&lock, 0x0);
+    pthread_mutex_init(&stats_lock, 0x0);
+  }
+  ~impl() {
+    pthread_rwlock_destroy(&lock);
+    pthread_mutex_destroy(&stats_lock);
+  }
+
+  /// Finds the closest learned glyph with only a few differing pixels
+  glyph_entry const *find(line_glyphs const &line, glyph const &g) const {
+    map<unsigned long, vector<glyph_entry> >::const_iterator const bucket = glyphs.find(glyph_key(g));
+    if(bucket == glyphs.end()) {
+      return 0x0;
+    }
+    glyph_entry const *best = 0x0;
+    unsigned best_diff = 0;
+    for(size_t i = 0; i < bucket->second.size(); ++i) {
+      glyph_entry const &entry = bucket->second[i];
+      unsigned const diff = difference(line, g, entry);
+      if(diff <= max(1u, entry.ink / 25) and (not best or diff < best_diff)) {
+        best = &entry;
+        best_diff = diff;
+      }
+    }
+    return best;
+  }
+
+  /// Whether a gap between two glyphs is a space: 1 yes, 0 no, -1 not known yet
+  int space(int gap) const {
+    if(max_letter_gap >= 0 and min_word_gap >= 0) {
+      return 2*gap > max_letter_gap + min_word_gap;
+    }
+    if(max_letter_gap >= 0 and gap <= max_letter_gap) {
+      return 0;
+    }
+    if(min_word_gap >= 0 and gap >= min_word_gap) {
+      return 1;
+    }
+    return -1;
+  }
+
+  map<unsigned long, vector<glyph_entry> > glyphs;
+  size_t count;
+  int max_letter_gap, min_word_gap; ///< learned gaps in pixels (-1 if unknown)
+  pthread_rwlock_t lock;
+
+  size_t hits, misses;
+  pthread_mutex_t stats_lock;
+};
+
+glyph_cache::glyph_cache()
+  : pimpl(new impl)
+{ }
+
+glyph_cache::~glyph_cache() {
+  delete pimpl;
+}
+
+bool glyph_cache::recognize(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                            ocr_result &result) {
+  line_glyphs line;
+  segment(image, width, height, stride, line);
+
+  bool known = not line.glyphs.empty();
+  string text;
+  vector<int> word_confidences;
+  int word_sum = 0, word_glyphs = 0;
+  pthread_rwlock_rdlock(&pimpl->lock);
+  for(size_t i = 0; i < line.glyphs.size() and known; ++i) {
+    glyph const &g = line.glyphs[i];
+    glyph_entry const *entry = pimpl->find(line, g);
+    if(not entry or entry->ambiguous()) {
+      known = false;
+      break;
+    }
+    if(i > 0) {
+      int const space = pimpl->space(g.left - line.glyphs[i - 1].right - 1);
+      if(space < 0) {
+        known = false;
+        break;
+      }
+      if(space) {
+        text += ' ';
+        word_confidences.push_back(word_sum / word_glyphs);
+        word_sum = word_glyphs = 0;
+      }
+    }
+    text += entry->text;
+    word_sum += entry->confidence();
+    ++word_glyphs;
+  }
+  pthread_rwlock_unlock(&pimpl->lock);
+
+  pthread_mutex_lock(&pimpl->stats_lock);
+  ++(known ? pimpl->hits : pimpl->misses);
+  pthread_mutex_unlock(&pimpl->stats_lock);
+  if(not known) {
+    return false;
+  }
+
+  word_confidences.push_back(word_sum / word_glyphs);
+  int sum = 0;
+  for(size_t i = 0; i < word_confidences.size(); ++i) {
+    sum += word_confidences[i];
+  }
+  result.text.swap(text);
+  result.word_confidences.swap(word_confidences);
+  result.confidence = sum / static_cast<int>(result.word_confidences.size());
+  result.symbols.clear();
+  return true;
+}
+
+namespace {
+/// What a glyph of a line was recognized as
+struct glyph_text {
+  glyph_text() : learn(false), word_start(false), confidence(100) { }
+  bool learn;
+  bool word_start;
+  int confidence;
+  string text;
+};
+}
+
+void glyph_cache::learn(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                        ocr_result const &result) {
+  if(result.symbols.empty()) {
+    return;
+  }
+  line_glyphs line;
+  segment(image, width, height, stride, line);
+
+  // a glyph is learned if all symbols overlapping it are centered on it
+  vector<glyph_text> texts(line.glyphs.size());
+  for(size_t i = 0; i < line.glyphs.size(); ++i) {
+    glyph const &g = line.glyphs[i];
+    glyph_text &t = texts[i];
+    bool found = false, centered = true;
+    for(size_t s = 0; s < result.symbols.size(); ++s) {
+      ocr_symbol const &symbol = result.symbols[s];
+      if(symbol.left > g.right or symbol.right <= g.left) {
+        continue;
+      }
+      unsigned const center = (symbol.left + symbol.right) / 2;
+      if(center < g.left or center > g.right or symbol.confidence < learn_confidence) {
+        centered = false;
+        break;
+      }
+      if(not found) {
+        t.word_start = symbol.word_start;
+      }
+      found = true;
+      t.text += symbol.text;
+      t.confidence = min(t.confidence, symbol.confidence);
+    }
+    t.learn = found and centered;
+  }
+
+  pthread_rwlock_wrlock(&pimpl->lock);
+  for(size_t i = 0; i < line.glyphs.size(); ++i) {
+    if(not texts[i].learn) {
+      continue;
+    }
+    glyph const &g = line.glyphs[i];
+    vector<glyph_entry> &bucket = pimpl->glyphs[glyph_key(g)];
+    glyph_entry *entry = 0x0;
+    for(size_t e = 0; e < bucket.size() and not entry; ++e) {
+      if(difference(line, g, bucket[e]) == 0) {
+        entry = &bucket[e];
+      }
+    }
+    if(not entry) {
+      bucket.push_back(glyph_entry());
+      entry = &bucket.back();
+      for(unsigned y = g.top; y <= g.bottom; ++y) {
+        entry->bits.insert(entry->bits.end(), &line.bits[y*line.width + g.left], &line.bits[y*line.width + g.right] + 1);
+      }
+      entry->ink = count(entry->bits.begin(), entry->bits.end(), 1);
+      ++pimpl->count;
+    }
+    unsigned const votes = ++entry->votes[texts[i].text];
+    if(votes > entry->text_votes) {
+      entry->text_votes = votes;
+      entry->text = texts[i].text;
+    }
+    ++entry->total_votes;
+    entry->confidence_sum += texts[i].confidence;
+
+    if(i > 0 and texts[i - 1].learn) {
+      int const gap = g.left - line.glyphs[i - 1].right - 1;
+      if(texts[i].word_start) {
+        pimpl->min_word_gap = pimpl->min_word_gap < 0 ? gap : min(pimpl->min_word_gap, gap);
+      }
+      else {
+        pimpl->max_letter_gap = max(pimpl->max_letter_gap, gap);
+      }
+    }
+  }
+  pthread_rwlock_unlock(&pimpl->lock);
+}
+
+size_t glyph_cache::glyphs() const {
+  pthread_rwlock_rdlock(&pimpl->lock);
+  size_t const count = pimpl->count;
+  pthread_rwlock_unlock(&pimpl->lock);
+  return count;
+}
+
+size_t glyph_cache::hits() const {
+  pthread_mutex_lock(&pimpl->stats_lock);
+  size_t const hits = pimpl->hits;
+  pthread_mutex_unlock(&pimpl->stats_lock);
+  return hits;
+}
+
+size_t glyph_cache::misses() const {
+  pthread_mutex_lock(&pimpl->stats_lock);
+  size_t const misses = pimpl->misses;
+  pthread_mutex_unlock(&pimpl->stats_lock);
+  return misses;
+}
+
+namespace {
+/// Only calls the engine for lines with unknown glyphs and learns from its results
+struct glyph_backend : public ocr_backend {
+  glyph_backend(ocr_backend *engine, glyph_cache &cache)
+    : engine(engine), cache(cache)
+  { }
+
+  ~glyph_backend() {
+    delete engine;
+  }
+
+  bool init(ocr_config const &config) {
+    return engine->init(config);
+  }
+
+  bool recognize(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                 ocr_result &result) {
+    if(cache.recognize(image, width, height, stride, result)) {
+      return true;
+    }
+    if(not engine->recognize(image, width, height, stride, result)) {
+      return false;
+    }
+    cache.learn(image, width, height, stride, result);
+    return true;
+  }
+
+  void shutdown() {
+    engine->shutdown();
+  }
+
+  bool concurrent() const {
+    return engine->concurrent();
+  }
+
+  ocr_backend *engine;
+  glyph_cache &cache;
+};
+}
+
+ocr_backend *create_glyph_backend(ocr_backend *engine, glyph_cache &cache) {
+  return new glyph_backend(engine, cache);
+}
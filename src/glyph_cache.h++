@@ -0,0 +1,69 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GLYPH_CACHE_HXX
+#define GLYPH_CACHE_HXX
+
+#include <cstddef>
+
+class ocr_backend;
+struct ocr_result;
+
+/**
+ * Recognizes text lines by their glyphs, learned from an OCR engine.
+ *
+ * All subtitles of a stream use the same bitmap font, so the same glyph
+ * bitmaps come up again and again.  A line is binarized and split into
+ * glyphs (connected components, merged if they overlap horizontally).  Each
+ * glyph of a line recognized by the engine is stored with the text of the
+ * symbols the engine found at its position.  A later line is recognized
+ * from the cache if all its glyphs are known, unambiguous and the word
+ * spacing is known.
+ *
+ * Thread-safe: one cache is shared by all engines.
+ */
+class glyph_cache {
+public:
+  glyph_cache();
+  ~glyph_cache();
+
+  /// Recognizes a single line.  Returns false if the line has an unknown glyph.
+  bool recognize(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                 ocr_result &result);
+  /// Learns the glyphs of a single line from the symbols recognized by an engine.
+  void learn(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+             ocr_result const &result);
+
+  size_t glyphs() const; ///< learned glyphs
+  size_t hits() const; ///< lines recognized from the cache
+  size_t misses() const; ///< lines passed to the engine
+
+private:
+  struct impl;
+  impl *pimpl;
+
+  // noncopyable
+  glyph_cache(glyph_cache const&);
+  glyph_cache &operator=(glyph_cache const&);
+};
+
+/// Wraps engine (and takes ownership of it): lines are recognized from cache if possible.
+ocr_backend *create_glyph_backend(ocr_backend *engine, glyph_cache &cache);
+
+#endif
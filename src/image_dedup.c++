@@ -0,0 +1,186 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "image_dedup.h++"
+#include <algorithm>
+
+namespace {
+enum { grid_rows = 4, grid_cols = 16 };
+
+/// Binarizes image into bits and crops it.  Returns false if there are no bright pixels.
+bool binarize(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+              std::vector<unsigned char> &bits, unsigned &crop_width, unsigned &crop_height) {
+  unsigned char max_value = 0;
+  for(unsigned y = 0; y < height; ++y) {
+    unsigned char const *row = image + y*stride;
+    max_value = std::max(max_value, *std::max_element(row, row + width));
+  }
+  if(max_value == 0) {
+    return false;
+  }
+  unsigned char const threshold = max_value / 2;
+
+  unsigned x0 = width, x1 = 0, y0 = height, y1 = 0;
+  for(unsigned y = 0; y < height; ++y) {
+    unsigned char const *row = image + y*stride;
+    for(unsigned x = 0; x < width; ++x) {
+      if(row[x] > threshold) {
+        x0 = std::min(x0, x);
+        x1 = std::max(x1, x);
+        y0 = std::min(y0, y);
+        y1 = std::max(y1, y);
+      }
+    }
+  }
+  crop_width = x1 - x0 + 1;
+  crop_height = y1 - y0 + 1;
+  bits.resize(crop_width * crop_height);
+  for(unsigned y = 0; y < crop_height; ++y) {
+    unsigned char const *row = image + (y0 + y)*stride + x0;
+    for(unsigned x = 0; x < crop_width; ++x) {
+      bits[y*crop_width + x] = row[x] > threshold;
+    }
+  }
+  return true;
+}
+
+/// One bit per grid cell: more than a quarter of the cell is ink.
+unsigned long long signature(std::vector<unsigned char> const &bits, unsigned width, unsigned height) {
+  unsigned long long sig = 0;
+  for(unsigned gy = 0; gy < grid_rows; ++gy) {
+    unsigned const ys = gy * height / grid_rows, ye = std::max((gy + 1) * height / grid_rows, ys + 1);
+    for(unsigned gx = 0; gx < grid_cols; ++gx) {
+      unsigned const xs = gx * width / grid_cols, xe = std::max((gx + 1) * width / grid_cols, xs + 1);
+      unsigned count = 0;
+      for(unsigned y = ys; y < ye and y < height; ++y) {
+        for(unsigned x = xs; x < xe and x < width; ++x) {
+          count += bits[y*width + x];
+        }
+      }
+      sig = (sig << 1) | (count * 4 > (ye - ys) * (xe - xs));
+    }
+  }
+  return sig;
+}
+
+/// Run lengths longer than this count as this
+enum { max_stroke = 16 };
+
+/// Median length of the horizontal ink runs, about the stroke width of the glyphs.
+unsigned stroke_width(std::vector<unsigned char> const &bits, unsigned width, unsigned height) {
+  unsigned histogram[max_stroke + 1] = { 0 };
+  unsigned runs = 0;
+  for(unsigned y = 0; y < height; ++y) {
+    unsigned char const *row = &bits[y*width];
+    for(unsigned x = 0; x < width; ) {
+      unsigned length = 0;
+      while(x < width and row[x]) {
+        ++length;
+        ++x;
+      }
+      if(length) {
+        ++histogram[std::min<unsigned>(length, max_stroke)];
+        ++runs;
+      }
+      else {
+        ++x;
+      }
+    }
+  }
+  unsigned count = 0;
+  for(unsigned length = 1; length < max_stroke; ++length) {
+    count += histogram[length];
+    if(2*count >= runs) {
+      return length;
+    }
+  }
+  return max_stroke;
+}
+
+/**
+ * Re-rendering the same text changes a few scattered pixels along the glyph
+ * edges.  Punctuation ('.' and ',', ':' and ';', an apostrophe) changes only
+ * a few pixels too, about a stroke width squared for small glyphs, and they
+ * form a blob.  So the images are the same if at most a stroke width
+ * squared (and at most max_differences) pixels differ and no 2x2 block of
+ * them differs.
+ */
+unsigned const max_differences = 8;
+
+/// Compares the pixels, pixels outside the common area differ if they are ink (see max_differences).
+bool same_pixels(std::vector<unsigned char> const &a, unsigned aw, unsigned ah,
+                 std::vector<unsigned char> const &b, unsigned bw, unsigned bh, unsigned stroke) {
+  unsigned const limit = std::min(max_differences, stroke*stroke);
+  unsigned const w = std::max(aw, bw), h = std::max(ah, bh);
+  std::vector<std::pair<unsigned, unsigned> > diff; // (y, x) in scan order
+  for(unsigned y = 0; y < h; ++y) {
+    for(unsigned x = 0; x < w; ++x) {
+      unsigned char const pa = x < aw and y < ah ? a[y*aw + x] : 0;
+      unsigned char const pb = x < bw and y < bh ? b[y*bw + x] : 0;
+      if(pa != pb) {
+        if(diff.size() == limit) {
+          return false;
+        }
+        diff.push_back(std::make_pair(y, x));
+      }
+    }
+  }
+  for(size_t i = 0; i < diff.size(); ++i) {
+    unsigned const y = diff[i].first, x = diff[i].second;
+    if(std::binary_search(diff.begin(), diff.end(), std::make_pair(y, x + 1)) and
+       std::binary_search(diff.begin(), diff.end(), std::make_pair(y + 1, x)) and
+       std::binary_search(diff.begin(), diff.end(), std::make_pair(y + 1, x + 1))) {
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+image_dedup::image_dedup()
+  : candidates_(0), rejected_(0)
+{ }
+
+long image_dedup::find_or_add(unsigned char const *image, unsigned width, unsigned height, unsigned stride, long id) {
+  unsigned w, h;
+  if(not binarize(image, width, height, stride, scratch, w, h)) {
+    return -1;
+  }
+  unsigned const stroke = stroke_width(scratch, w, h);
+  std::vector<entry> &bucket = entries[signature(scratch, w, h)];
+  for(size_t i = 0; i < bucket.size(); ++i) {
+    entry const &e = bucket[i];
+    if(std::max(e.width, w) - std::min(e.width, w) > 1 or std::max(e.height, h) - std::min(e.height, h) > 1) {
+      continue;
+    }
+    ++candidates_;
+    if(same_pixels(e.bits, e.width, e.height, scratch, w, h, std::min(e.stroke, stroke))) {
+      return e.id;
+    }
+    ++rejected_;
+  }
+  bucket.push_back(entry());
+  entry &e = bucket.back();
+  e.id = id;
+  e.width = w;
+  e.height = h;
+  e.stroke = stroke;
+  e.bits.swap(scratch);
+  return -1;
+}
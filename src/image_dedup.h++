@@ -0,0 +1,61 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGE_DEDUP_HXX
+#define IMAGE_DEDUP_HXX
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+/**
+ * Finds near-duplicate subtitle images, e.g. the same line rendered a few
+ * pixels lower or with a different palette or fade alpha.
+ *
+ * Images are binarized at half their brightest value and cropped to the
+ * binarized pixels, which makes them independent of position and palette.
+ * A coarse signature (ink density on a grid) selects candidates.  They are
+ * verified by comparing the binarized pixels: only a few scattered pixels,
+ * fewer for thinner strokes, may differ, so lines that differ in
+ * punctuation are not merged.
+ */
+class image_dedup {
+public:
+  image_dedup();
+
+  /// Returns the id of an earlier image that looks the same.  Otherwise adds the image as id and returns -1.
+  long find_or_add(unsigned char const *image, unsigned width, unsigned height, unsigned stride, long id);
+
+  size_t candidates() const { return candidates_; } ///< signature matches
+  size_t rejected() const { return rejected_; } ///< signature matches that differed
+
+private:
+  struct entry {
+    long id;
+    unsigned width, height;
+    unsigned stroke; ///< median ink run length
+    std::vector<unsigned char> bits; ///< binarized and cropped, one byte per pixel
+  };
+
+  std::map<unsigned long long, std::vector<entry> > entries;
+  std::vector<unsigned char> scratch;
+  size_t candidates_, rejected_;
+};
+
+#endif
@@ -0,0 +1,252 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "image_dump.h++"
+#include "output_buffer.h++"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+using namespace std;
+
+namespace {
+/// Image data that is still pending is limited to this many bytes
+size_t const max_pending = 64 * 1024 * 1024;
+
+/// A queued image with packed rows
+struct dump_image {
+  unsigned number, width, height;
+  vector<unsigned char> pixels;
+};
+
+/// Writes value as an octal number with a trailing '\0' into a tar header field of size bytes
+void tar_octal(char *field, size_t size, unsigned long value) {
+  field[size-1] = '\0';
+  for(size_t i = size-1; i > 0; --i) {
+    field[i-1] = char('0' + (value & 7));
+    value >>= 3;
+  }
+}
+}
+
+struct image_dumper::impl {
+  impl(string const &basename, format_t format)
+    : basename(basename), format(format), tar(0x0), tar_buffer(0x0), mtime(time(0x0)),
+      pending(0), done(false), threaded(false), failed(false)
+  {
+    // names in the archive do not have the directory
+    size_t const slash = basename.rfind('/');
+    entry_basename = slash == string::npos ? basename : basename.substr(slash+1);
+    if(format == tar_archive) {
+      string const filename = basename + "-images.tar";
+      tar = fopen(filename.c_str(), "wb");
+      if(tar) {
+        tar_buffer = new output_buffer(tar);
+      }
+      else {
+        fail(filename);
+      }
+    }
+    pthread_mutex_init(&lock, 0x0);
+    pthread_cond_init(&ready, 0x0);
+    pthread_cond_init(&room, 0x0);
+    threaded = pthread_create(&thread, 0x0, run, this) == 0; // without a thread images are written in dump
+  }
+
+  ~impl() {
+    pthread_cond_destroy(&room);
+    pthread_cond_destroy(&ready);
+    pthread_mutex_destroy(&lock);
+  }
+
+  static void *run(void *arg) {
+    impl *self = static_cast<impl*>(arg);
+    for(;;) {
+      pthread_mutex_lock(&self->lock);
+      while(self->queue.empty() and not self->done) {
+        pthread_cond_wait(&self->ready, &self->lock);
+      }
+      if(self->queue.empty()) {
+        pthread_mutex_unlock(&self->lock);
+        break;
+      }
+      dump_image *image = self->queue.front();
+      self->queue.pop_front();
+      pthread_mutex_unlock(&self->lock);
+
+      self->write(*image);
+
+      pthread_mutex_lock(&self->lock);
+      self->pending -= image->pixels.size();
+      pthread_cond_signal(&self->room);
+      pthread_mutex_unlock(&self->lock);
+      delete image;
+    }
+    return 0x0;
+  }
+
+  void write(dump_image const &image) {
+    char const *const pixels = image.pixels.empty() ? "" : reinterpret_cast<char const*>(&image.pixels[0]);
+    char name[500];
+    snprintf(name, sizeof(name), "-%04u.pgm", image.number);
+    char header[64];
+    int const header_size = snprintf(header, sizeof(header), "P5\n%u %u %u\n", image.width, image.height, 255u);
+
+    if(format == pgm_files) {
+      string const filename = basename + name;
+      FILE *pgm = fopen(filename.c_str(), "wb");
+      if(not pgm) {
+        fail(filename);
+        return;
+      }
+      fwrite(header, 1, header_size, pgm);
+      fwrite(pixels, 1, image.pixels.size(), pgm);
+      bool const written = not ferror(pgm);
+      if(fclose(pgm) != 0 or not written) {
+        fail(filename);
+      }
+    }
+    else if(tar_buffer) {
+      size_t const size = header_size + image.pixels.size();
+      write_tar_header(entry_basename + name, size);
+      tar_buffer->append(header, header_size);
+      tar_buffer->append(pixels, image.pixels.size());
+      static char const zeros[512] = { 0 };
+      tar_buffer->append(zeros, (512 - size % 512) % 512);
+    }
+  }
+
+  /// ustar header of a regular file
+  void write_tar_header(string const &name, size_t size) {
+    char header[512];
+    memset(header, 0, sizeof(header));
+    // the name field has 100 bytes, keep the end with the number
+    size_t const offset = name.size() > 99 ? name.size() - 99 : 0;
+    memcpy(header, name.data() + offset, name.size() - offset);
+    tar_octal(header + 100, 8, 0644); // mode
+    tar_octal(header + 108, 8, 0); // uid
+    tar_octal(header + 116, 8, 0); // gid
+    tar_octal(header + 124, 12, size);
+    tar_octal(header + 136, 12, static_cast<unsigned long>(mtime));
+    header[156] = '0'; // regular file
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+    // the checksum is computed with the checksum field set to spaces
+    memset(header + 148, ' ', 8);
+    unsigned long checksum = 0;
+    for(size_t i = 0; i < sizeof(header); ++i) {
+      checksum += static_cast<unsigned char>(header[i]);
+    }
+    tar_octal(header + 148, 7, checksum);
+    tar_buffer->append(header, sizeof(header));
+  }
+
+  /// Remembers the first error (errno is still set)
+  void fail(string const &filename) {
+    if(not failed) {
+      error = filename + ": " + strerror(errno);
+      failed = true;
+    }
+  }
+
+  string basename, entry_basename;
+  format_t format;
+  FILE *tar;
+  output_buffer *tar_buffer;
+  time_t mtime;
+
+  deque<dump_image*> queue;
+  size_t pending; ///< bytes in queue
+  bool done;
+  pthread_mutex_t lock;
+  pthread_cond_t ready; ///< queue not empty or done
+  pthread_cond_t room; ///< pending went down
+  pthread_t thread;
+  bool threaded;
+
+  bool failed; ///< only written by the writer (or after it stopped)
+  string error;
+};
+
+image_dumper::image_dumper(std::string const &basename, format_t format)
+  : pimpl(new impl(basename, format))
+{ }
+
+image_dumper::~image_dumper() {
+  finish();
+  delete pimpl;
+}
+
+void image_dumper::dump(unsigned number, unsigned char const *image, unsigned width, unsigned height,
+                        unsigned stride) {
+  dump_image *copy = new dump_image;
+  copy->number = number;
+  copy->width = width;
+  copy->height = height;
+  copy->pixels.resize(size_t(width) * height);
+  for(unsigned y = 0; y < height; ++y) {
+    memcpy(&copy->pixels[size_t(y) * width], image + size_t(y) * stride, width);
+  }
+
+  if(not pimpl->threaded) {
+    pimpl->write(*copy);
+    delete copy;
+    return;
+  }
+  pthread_mutex_lock(&pimpl->lock);
+  while(pimpl->pending > max_pending) {
+    pthread_cond_wait(&pimpl->room, &pimpl->lock);
+  }
+  pimpl->queue.push_back(copy);
+  pimpl->pending += copy->pixels.size();
+  pthread_cond_signal(&pimpl->ready);
+  pthread_mutex_unlock(&pimpl->lock);
+}
+
+bool image_dumper::finish() {
+  if(pimpl->threaded) {
+    pthread_mutex_lock(&pimpl->lock);
+    pimpl->done = true;
+    pthread_cond_signal(&pimpl->ready);
+    pthread_mutex_unlock(&pimpl->lock);
+    pthread_join(pimpl->thread, 0x0);
+    pimpl->threaded = false;
+  }
+  if(pimpl->tar) {
+    static char const end_of_archive[1024] = { 0 };
+    pimpl->tar_buffer->append(end_of_archive, sizeof(end_of_archive));
+    bool const flushed = pimpl->tar_buffer->flush();
+    delete pimpl->tar_buffer;
+    pimpl->tar_buffer = 0x0;
+    if(fclose(pimpl->tar) != 0 or not flushed) {
+      pimpl->fail(pimpl->basename + "-images.tar");
+    }
+    pimpl->tar = 0x0;
+  }
+  return not pimpl->failed;
+}
+
+std::string const &image_dumper::error() const {
+  return pimpl->error;
+}
@@ -0,0 +1,54 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IMAGE_DUMP_HXX
+#define IMAGE_DUMP_HXX
+
+#include <string>
+
+/**
+ * Writes the subtitle images (--dump-images) in a background thread, either
+ * as single PGM files <basename>-<number>.pgm or as one tar archive
+ * <basename>-images.tar with the same PGM files.  dump copies the image, so
+ * the caller does not wait for the file system.
+ */
+class image_dumper {
+public:
+  enum format_t { pgm_files, tar_archive };
+
+  image_dumper(std::string const &basename, format_t format);
+  ~image_dumper(); ///< calls finish
+
+  /// Queues a copy of the image.  Blocks while too much image data is pending.
+  void dump(unsigned number, unsigned char const *image, unsigned width, unsigned height, unsigned stride);
+  /// Writes the pending images and stops the thread.  Returns false if writing failed (see error).
+  bool finish();
+  /// The first error
+  std::string const &error() const;
+
+private:
+  struct impl;
+  impl *pimpl;
+
+  // noncopyable
+  image_dumper(image_dumper const&);
+  image_dumper &operator=(image_dumper const&);
+};
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "line_split.h++"
+#include <algorithm>
+#include <climits>
+
+namespace {
+bool row_empty(unsigned char const *row, unsigned width, unsigned char threshold) {
+  for(unsigned x = 0; x < width; ++x) {
+    if(row[x] > threshold) {
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+void split_lines(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                 std::vector<text_line> &lines, unsigned char threshold) {
+  lines.clear();
+  unsigned start = 0;
+  bool in_line = false;
+  for(unsigned y = 0; y < height; ++y) {
+    bool const empty = row_empty(image + y*stride, width, threshold);
+    if(not empty and not in_line) {
+      start = y;
+      in_line = true;
+    }
+    else if(empty and in_line) {
+      lines.push_back(text_line(start, y - start));
+      in_line = false;
+    }
+  }
+  if(in_line) {
+    lines.push_back(text_line(start, height - start));
+  }
+
+  unsigned max_height = 0;
+  for(size_t i = 0; i < lines.size(); ++i) {
+    max_height = std::max(max_height, lines[i].height);
+  }
+
+  // merge small fragments into the closest neighbour
+  size_t i = 0;
+  while(lines.size() > 1 and i < lines.size()) {
+    if(lines[i].height * 3 >= max_height) {
+      ++i;
+      continue;
+    }
+    unsigned const gap_above = i == 0 ? UINT_MAX : lines[i].y - (lines[i-1].y + lines[i-1].height);
+    unsigned const gap_below = i + 1 == lines.size() ? UINT_MAX : lines[i+1].y - (lines[i].y + lines[i].height);
+    size_t const into = gap_above <= gap_below ? i - 1 : i + 1;
+    if(std::min(gap_above, gap_below) * 2 > max_height) { // too far away, a line on its own
+      ++i;
+      continue;
+    }
+    unsigned const top = std::min(lines[i].y, lines[into].y);
+    unsigned const bottom = std::max(lines[i].y + lines[i].height, lines[into].y + lines[into].height);
+    lines[into] = text_line(top, bottom - top);
+    lines.erase(lines.begin() + i);
+    if(into < i) {
+      i = into; // the merged line might be the next small one
+    }
+  }
+}
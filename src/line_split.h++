@@ -0,0 +1,43 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINE_SPLIT_HXX
+#define LINE_SPLIT_HXX
+
+#include <vector>
+
+/// A text line of a subtitle image (rows [y, y + height))
+struct text_line {
+  text_line(unsigned y, unsigned height) : y(y), height(height) { }
+  unsigned y, height;
+};
+
+/**
+ * Splits a subtitle image into text lines by horizontal projection.
+ *
+ * Rows without a pixel brighter than threshold separate lines.  Lines lower
+ * than a third of the highest line (dots, accents, underscores) are merged
+ * into the closest neighbour, unless it is more than half a line away.  The
+ * lines are stored in order from top to bottom.  An empty image results in
+ * no lines.
+ */
+void split_lines(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                 std::vector<text_line> &lines, unsigned char threshold = 0);
+
+#endif
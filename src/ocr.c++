@@ -0,0 +1,316 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ocr.h++"
+#include "ocr_backend.h++"
+#include "glyph_cache.h++"
+#include "ocr_preprocess.h++"
+#include "stats.h++"
+
+#include <pthread.h>
+#include <algorithm>
+#include <cctype>
+using namespace std;
+
+namespace {
+void trim_right(string &text) {
+  size_t size = text.size();
+  while(size > 0 and isspace(static_cast<unsigned char>(text[size - 1]))) {
+    --size;
+  }
+  text.resize(size);
+}
+
+void recognize(ocr_backend *engine, ocr_job &job) {
+  if(not engine->recognize(job.image, job.width, job.height, job.stride, job)) {
+    job.failed = true;
+    job.text.clear();
+    return;
+  }
+  trim_right(job.text);
+}
+
+/// Work shared by the OCR threads.  Jobs are taken in order.
+struct batch {
+  vector<ocr_job> *jobs;
+  unsigned size; ///< jobs per recognize call
+  ocr_observer *observer;
+  size_t next;
+  pthread_mutex_t lock;
+};
+
+struct worker {
+  batch *work;
+  ocr_backend *engine;
+  size_t calls;
+  vector<unsigned char> page;
+  vector<unsigned> offsets;
+  vector<ocr_line> lines;
+  vector<int> confidence_count;
+};
+
+/// Stacks jobs [first, last) into one page, separated by empty gaps, and
+/// assigns the lines found by the engine back by their vertical center.
+bool recognize_page(worker &w, vector<ocr_job> &jobs, size_t first, size_t last) {
+  unsigned max_width = 0, max_height = 0;
+  for(size_t i = first; i < last; ++i) {
+    max_width = max(max_width, jobs[i].width);
+    max_height = max(max_height, jobs[i].height);
+  }
+  unsigned const gap = max(max_height, 8u);
+  unsigned const margin = 8;
+  unsigned const stride = (max_width + 2*margin + 7) & ~7u;
+  unsigned height = gap;
+  w.offsets.clear();
+  for(size_t i = first; i < last; ++i) {
+    w.offsets.push_back(height);
+    height += jobs[i].height + gap;
+  }
+  w.page.assign(static_cast<size_t>(stride) * height, 0);
+  for(size_t i = first; i < last; ++i) {
+    ocr_job const &job = jobs[i];
+    unsigned char *dst = &w.page[static_cast<size_t>(w.offsets[i - first]) * stride + margin];
+    for(unsigned y = 0; y < job.height; ++y) {
+      copy(job.image + y*job.stride, job.image + y*job.stride + job.width, dst + y*stride);
+    }
+  }
+
+  ++w.calls;
+  if(not w.engine->recognize_lines(&w.page[0], stride, height, stride, w.lines)) {
+    return false;
+  }
+
+  w.confidence_count.assign(last - first, 0);
+  for(size_t i = first; i < last; ++i) {
+    jobs[i].text.clear();
+    jobs[i].confidence = 0;
+    jobs[i].word_confidences.clear();
+  }
+  for(size_t l = 0; l < w.lines.size(); ++l) {
+    unsigned const center = (w.lines[l].top + w.lines[l].bottom) / 2;
+    for(size_t i = first; i < last; ++i) {
+      unsigned const top = w.offsets[i - first];
+      if(center + gap/2 >= top and center < top + jobs[i].height + gap/2) {
+        string text = w.lines[l].text;
+        trim_right(text);
+        if(text.empty()) {
+          break;
+        }
+        if(not jobs[i].text.empty()) {
+          jobs[i].text += '\n';
+        }
+        jobs[i].text += text;
+        // running mean of the line confidences
+        int &n = w.confidence_count[i - first];
+        jobs[i].confidence = (jobs[i].confidence * n + w.lines[l].confidence) / (n + 1);
+        ++n;
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+void *run_worker(void *arg) {
+  worker *w = static_cast<worker*>(arg);
+  vector<ocr_job> &jobs = *w->work->jobs;
+  for(;;) {
+    pthread_mutex_lock(&w->work->lock);
+    size_t const first = w->work->next;
+    size_t const last = min(jobs.size(), first + w->work->size);
+    w->work->next = last;
+    pthread_mutex_unlock(&w->work->lock);
+    if(first >= last) {
+      break;
+    }
+    double const start = seconds();
+    if(not (last - first > 1 and recognize_page(*w, jobs, first, last))) {
+      for(size_t i = first; i < last; ++i) { // single job or the page failed
+        ++w->calls;
+        recognize(w->engine, jobs[i]);
+      }
+    }
+    double const each = (seconds() - start) / (last - first);
+    for(size_t i = first; i < last; ++i) {
+      jobs[i].seconds = each;
+      if(w->work->observer) {
+        w->work->observer->finished(i, jobs[i]);
+      }
+    }
+  }
+  return 0x0;
+}
+}
+
+struct ocr_engines::impl {
+  impl() : glyphs(0x0) { }
+  vector<ocr_backend*> engines;
+  glyph_cache *glyphs;
+};
+
+ocr_engines::ocr_engines()
+  : pimpl(new impl)
+{ }
+
+ocr_engines::~ocr_engines() {
+  for(size_t i = 0; i < pimpl->engines.size(); ++i) {
+    pimpl->engines[i]->shutdown();
+    delete pimpl->engines[i];
+  }
+  delete pimpl->glyphs;
+  delete pimpl;
+}
+
+bool ocr_engines::init(ocr_config const &config, unsigned count) {
+  for(unsigned i = 0; i < count or i == 0; ++i) {
+    ocr_backend *engine = create_ocr_backend(config.backend);
+    if(not engine) {
+      break;
+    }
+    if(config.scale > 1 or config.binarize) {
+      engine = create_preprocess_backend(engine, config.scale, config.binarize);
+    }
+    if(config.glyph_cache) {
+      if(not pimpl->glyphs) {
+        pimpl->glyphs = new glyph_cache;
+      }
+      engine = create_glyph_backend(engine, *pimpl->glyphs);
+    }
+    if(not engine->init(config)) {
+      delete engine;
+      break;
+    }
+    pimpl->engines.push_back(engine);
+    if(not engine->concurrent()) {
+      break;
+    }
+  }
+  return not pimpl->engines.empty();
+}
+
+unsigned ocr_engines::size() const {
+  return pimpl->engines.size();
+}
+
+bool ocr_engines::concurrent() const {
+  return not pimpl->engines.empty() and pimpl->engines.front()->concurrent();
+}
+
+glyph_cache const *ocr_engines::glyphs() const {
+  return pimpl->glyphs;
+}
+
+bool ocr_set_profile(ocr_config &config, string const &name) {
+  if(name == "fast") {
+    config.engine = ocr_config::engine_fast;
+    if(config.layout == ocr_config::layout_line) {
+      config.layout = ocr_config::layout_raw_line;
+    }
+    config.variables.push_back(make_pair("tessedit_enable_doc_dict", "0"));
+  }
+  else if(name == "balanced") {
+    config.engine = ocr_config::engine_default;
+  }
+  else if(name == "accurate") {
+    config.engine = ocr_config::engine_accurate;
+  }
+  else {
+    return false;
+  }
+  return true;
+}
+
+void ocr_select_timed_out(vector<ocr_job> const &jobs, vector<size_t> &selected) {
+  selected.clear();
+  for(size_t i = 0; i < jobs.size(); ++i) {
+    if(jobs[i].failed and jobs[i].timed_out) {
+      selected.push_back(i);
+    }
+  }
+}
+
+void ocr_select_low_confidence(vector<ocr_job> const &jobs, vector<vector<size_t> > const &cue_jobs,
+                               int threshold, vector<size_t> &selected) {
+  vector<bool> select(jobs.size());
+  for(size_t c = 0; c < cue_jobs.size(); ++c) {
+    bool failed = false;
+    int sum = 0, known = 0;
+    for(size_t i = 0; i < cue_jobs[c].size(); ++i) {
+      ocr_job const &job = jobs[cue_jobs[c][i]];
+      if(job.failed) {
+        failed = true;
+      }
+      else if(not job.text.empty() and job.confidence >= 0) {
+        sum += job.confidence;
+        ++known;
+      }
+    }
+    if(failed or (known > 0 and sum < threshold * known)) {
+      for(size_t i = 0; i < cue_jobs[c].size(); ++i) {
+        ocr_job const &job = jobs[cue_jobs[c][i]];
+        if(job.failed or not job.text.empty()) {
+          select[cue_jobs[c][i]] = true;
+        }
+      }
+    }
+  }
+  selected.clear();
+  for(size_t i = 0; i < jobs.size(); ++i) {
+    if(select[i]) {
+      selected.push_back(i);
+    }
+  }
+}
+
+size_t ocr_engines::run(vector<ocr_job> &jobs, unsigned batch_size, ocr_observer *observer) {
+  if(pimpl->engines.empty()) {
+    return 0;
+  }
+  batch work;
+  work.jobs = &jobs;
+  work.size = max(batch_size, 1u);
+  work.observer = observer;
+  work.next = 0;
+  pthread_mutex_init(&work.lock, 0x0);
+
+  size_t const pages = (jobs.size() + work.size - 1) / work.size;
+  size_t const count = min(pimpl->engines.size(), max(pages, size_t(1)));
+  vector<worker> workers(count);
+  vector<pthread_t> threads(count);
+  size_t started = 1;
+  for(size_t i = 0; i < count; ++i) {
+    workers[i].work = &work;
+    workers[i].engine = pimpl->engines[i];
+    workers[i].calls = 0;
+  }
+  while(started < count and pthread_create(&threads[started], 0x0, run_worker, &workers[started]) == 0) {
+    ++started;
+  }
+  run_worker(&workers[0]); // the calling thread uses the first engine
+  for(size_t i = 1; i < started; ++i) {
+    pthread_join(threads[i], 0x0);
+  }
+  pthread_mutex_destroy(&work.lock);
+
+  size_t calls = 0;
+  for(size_t i = 0; i < count; ++i) {
+    calls += workers[i].calls;
+  }
+  return calls;
+}
@@ -0,0 +1,136 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OCR_HXX
+#define OCR_HXX
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ocr_backend.h++"
+
+class glyph_cache;
+
+/// Settings shared by all OCR engines
+struct ocr_config {
+  /// How the engine should look for text in an image
+  enum layout_t {
+    layout_auto,  ///< full layout analysis
+    layout_line,  ///< a single line of text
+    layout_raw_line, ///< a single line of text, without any layout analysis
+    layout_block  ///< a uniform block of text lines
+  };
+  /// Which recognizer to use
+  enum engine_t {
+    engine_default,  ///< tesseract: the default engine of the traineddata
+    engine_fast,     ///< prefer speed (tesseract: legacy engine)
+    engine_accurate  ///< prefer accuracy (tesseract: LSTM and legacy engine combined)
+  };
+
+  ocr_config()
+    : backend("tesseract"), data_path(0x0), layout(layout_auto), engine(engine_default), scale(1),
+      binarize(false), glyph_cache(false), timeout_ms(0)
+  { }
+  std::string backend; ///< see create_ocr_backend
+  char const *data_path; ///< tesseract data path (0x0 for the builtin default)
+  std::string lang;
+  std::string blacklist;
+  layout_t layout;
+  engine_t engine;
+  std::vector<std::pair<std::string, std::string> > variables; ///< tesseract variables, set in this order
+  unsigned scale; ///< upscale images by this factor before the OCR (see ocr_preprocessor)
+  bool binarize; ///< binarize images before the OCR
+  bool glyph_cache; ///< recognize known glyphs without the engine (single lines only, see glyph_cache)
+  unsigned timeout_ms; ///< cancel the recognition of an image after this time (0: no limit)
+};
+
+/// An image to recognize (not owned) and the recognized text (trailing whitespace removed)
+struct ocr_job : public ocr_result {
+  ocr_job(unsigned char const *image, unsigned width, unsigned height, unsigned stride)
+    : image(image), width(width), height(height), stride(stride), failed(false), seconds(0)
+  { }
+  unsigned char const *image;
+  unsigned width, height, stride;
+  bool failed;
+  double seconds; ///< time spent by ocr_engines::run (a batch is split evenly)
+};
+
+/// Gets the jobs of ocr_engines::run as soon as they are recognized.  Called by the OCR threads.
+class ocr_observer {
+public:
+  virtual ~ocr_observer() { }
+  /// index is the position of job in the jobs of the run
+  virtual void finished(size_t index, ocr_job const &job) = 0;
+};
+
+/// A set of OCR engines (see ocr_backend).  Every engine is used by one thread at a time.
+class ocr_engines {
+public:
+  ocr_engines();
+  ~ocr_engines();
+
+  /// Starts up to count engines (only one if the backend is not concurrent).  Returns false on failure.
+  bool init(ocr_config const &config, unsigned count);
+  /**
+   * Recognizes all jobs, distributing them over the engines.
+   *
+   * With batch > 1 up to batch consecutive jobs are stacked into one image
+   * and recognized at once (see ocr_backend::recognize_lines).  The engines
+   * should use layout_block then.  observer (if not 0x0) gets every
+   * finished job.  Returns the number of recognize calls.
+   */
+  size_t run(std::vector<ocr_job> &jobs, unsigned batch = 1, ocr_observer *observer = 0x0);
+  unsigned size() const;
+  /// Whether the engines are independent instances (e.g. not the old static tesseract API).
+  bool concurrent() const;
+  /// The glyph cache shared by the engines (0x0 without ocr_config::glyph_cache)
+  glyph_cache const *glyphs() const;
+
+private:
+  struct impl;
+  impl *pimpl;
+
+  // noncopyable
+  ocr_engines(ocr_engines const&);
+  ocr_engines &operator=(ocr_engines const&);
+};
+
+/**
+ * Applies the OCR profile called name: "fast" (legacy engine, no layout
+ * analysis for lines), "balanced" (default engine) or "accurate" (combined
+ * engines).  Variables of the profile are appended to config.variables.
+ * Returns false for an unknown name.
+ */
+bool ocr_set_profile(ocr_config &config, std::string const &name);
+
+/// Stores the indices of the jobs that were cancelled after ocr_config::timeout_ms.
+void ocr_select_timed_out(std::vector<ocr_job> const &jobs, std::vector<size_t> &selected);
+
+/**
+ * Stores the indices (in order) of the jobs to re-run for tiered OCR.  cue_jobs
+ * lists the jobs of the lines of each cue.  A cue is selected if one of its
+ * jobs failed or if the mean known confidence of its jobs is below threshold.
+ * Jobs without text (that did not fail) are blank lines: they are neither
+ * counted nor selected.
+ */
+void ocr_select_low_confidence(std::vector<ocr_job> const &jobs, std::vector<std::vector<size_t> > const &cue_jobs,
+                               int threshold, std::vector<size_t> &selected);
+
+#endif
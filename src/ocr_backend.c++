@@ -0,0 +1,73 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ocr_backend.h++"
+#include "line_split.h++"
+#include <cstdio>
+
+bool ocr_backend::recognize_lines(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                                  std::vector<ocr_line> &lines) {
+  std::vector<text_line> found;
+  split_lines(image, width, height, stride, found);
+  lines.clear();
+  ocr_result result;
+  for(size_t i = 0; i < found.size(); ++i) {
+    if(not recognize(image + found[i].y * stride, width, found[i].height, stride, result)) {
+      return false;
+    }
+    lines.push_back(ocr_line(found[i].y, found[i].y + found[i].height, result.text, result.confidence));
+  }
+  return true;
+}
+
+namespace {
+/// Does no OCR at all.  Useful to measure the demuxing and decoding alone.
+/// The text is the image size, so the output still shows all subtitles.
+struct null_backend : public ocr_backend {
+  bool init(ocr_config const &) {
+    return true;
+  }
+
+  bool recognize(unsigned char const *, unsigned width, unsigned height, unsigned,
+                 ocr_result &result) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%ux%u", width, height);
+    result.text = buf;
+    result.confidence = 100;
+    result.word_confidences.assign(1, 100);
+    return true;
+  }
+
+  void shutdown() { }
+
+  bool concurrent() const {
+    return true;
+  }
+};
+}
+
+ocr_backend *create_ocr_backend(std::string const &name) {
+  if(name == "tesseract") {
+    return create_tesseract_backend();
+  }
+  if(name == "null") {
+    return new null_backend;
+  }
+  return 0x0;
+}
@@ -0,0 +1,98 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OCR_BACKEND_HXX
+#define OCR_BACKEND_HXX
+
+#include <string>
+#include <vector>
+
+struct ocr_config;
+
+/// A character (or ligature) found by ocr_backend::recognize
+struct ocr_symbol {
+  ocr_symbol(unsigned left, unsigned right, std::string const &text, int confidence, bool word_start)
+    : left(left), right(right), text(text), confidence(confidence), word_start(word_start)
+  { }
+  unsigned left, right; ///< columns [left, right) of the image
+  std::string text;
+  int confidence;
+  bool word_start; ///< first symbol of a word
+};
+
+/// Result of ocr_backend::recognize
+struct ocr_result {
+  ocr_result() : confidence(-1), timed_out(false) { }
+  std::string text;
+  int confidence; ///< mean word confidence 0-100 (-1 if unknown)
+  std::vector<int> word_confidences; ///< per word (empty if unknown)
+  std::vector<ocr_symbol> symbols; ///< only with ocr_config::glyph_cache (empty if unknown)
+  bool timed_out; ///< recognize failed because it took longer than ocr_config::timeout_ms
+};
+
+/// A text line found by ocr_backend::recognize_lines
+struct ocr_line {
+  ocr_line(unsigned top, unsigned bottom, std::string const &text, int confidence)
+    : top(top), bottom(bottom), text(text), confidence(confidence)
+  { }
+  unsigned top, bottom; ///< rows [top, bottom) of the image
+  std::string text;
+  int confidence;
+};
+
+/**
+ * Interface of an OCR engine.
+ *
+ * An instance is only used by one thread at a time.  If concurrent() is
+ * true, several instances may be used in parallel.
+ */
+class ocr_backend {
+public:
+  virtual ~ocr_backend() { }
+
+  /// Loads the engine.  Returns false on failure.
+  virtual bool init(ocr_config const &config) = 0;
+  /**
+   * Recognizes an 8 bit gray image (bright text on a dark background).
+   *
+   * Stores the text and the confidences in result, reusing its storage.
+   * Returns false on failure (setting result.timed_out on a timeout).
+   */
+  virtual bool recognize(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                         ocr_result &result) = 0;
+  /**
+   * Recognizes an image containing several lines of text and stores each
+   * line with its position.  The default implementation splits the image
+   * with split_lines and calls recognize for each line.
+   */
+  virtual bool recognize_lines(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                               std::vector<ocr_line> &lines);
+  /// Releases the engine.  Called once before destruction if init succeeded.
+  virtual void shutdown() = 0;
+  /// Whether several instances can be used at the same time.
+  virtual bool concurrent() const = 0;
+};
+
+/// Creates the backend called name ("tesseract" or "null").  Returns 0x0 if there is no such backend.
+ocr_backend *create_ocr_backend(std::string const &name);
+
+/// Creates the Tesseract backend (tesseract_backend.c++)
+ocr_backend *create_tesseract_backend();
+
+#endif
@@ -0,0 +1,279 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ocr_journal.h++"
+#include "stats.h++"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace std;
+
+/*
+ * Every result is one line with tab separated fields:
+ *
+ *   stream start_pts hash pass confidence flags text
+ *
+ * hash has 16 hex digits, pass is ocr, retry or tier, flags are f (failed)
+ * and t (timed out) or - and '\\', '\n', '\r' and '\t' in the text are
+ * escaped with a backslash.  Lines starting with # are comments.
+ */
+
+namespace {
+char const *const header = "# vobsub2srt OCR journal 1\n";
+char const *const pass_names[] = { "ocr", "retry", "tier" };
+
+/// Results are forced to the disk at most this often (seconds)
+double const sync_interval = 1.0;
+
+/// Splits line at the tabs into at most count fields.  The last field gets the rest.
+bool split_fields(string const &line, string *fields, size_t count) {
+  size_t start = 0;
+  for(size_t i = 0; i + 1 < count; ++i) {
+    size_t const tab = line.find('\t', start);
+    if(tab == string::npos) {
+      return false;
+    }
+    fields[i] = line.substr(start, tab - start);
+    start = tab + 1;
+  }
+  fields[count-1] = line.substr(start);
+  return true;
+}
+
+bool parse_number(string const &field, long &value) {
+  char *end;
+  errno = 0;
+  value = strtol(field.c_str(), &end, 10);
+  return not field.empty() and *end == '\0' and errno == 0;
+}
+
+bool parse_number(string const &field, unsigned long &value) {
+  char *end;
+  errno = 0;
+  value = strtoul(field.c_str(), &end, 10);
+  return not field.empty() and field[0] != '-' and *end == '\0' and errno == 0;
+}
+
+bool parse_hash(string const &field, unsigned long long &hash) {
+  if(field.size() != 16) {
+    return false;
+  }
+  hash = 0;
+  for(size_t i = 0; i < field.size(); ++i) {
+    char const c = field[i];
+    unsigned digit;
+    if(c >= '0' and c <= '9') {
+      digit = c - '0';
+    }
+    else if(c >= 'a' and c <= 'f') {
+      digit = c - 'a' + 10;
+    }
+    else {
+      return false;
+    }
+    hash = hash << 4 | digit;
+  }
+  return true;
+}
+
+bool unescape(string const &field, string &text) {
+  text.clear();
+  for(size_t i = 0; i < field.size(); ++i) {
+    if(field[i] != '\\') {
+      text += field[i];
+      continue;
+    }
+    if(++i == field.size()) {
+      return false;
+    }
+    switch(field[i]) {
+    case '\\': text += '\\'; break;
+    case 'n': text += '\n'; break;
+    case 'r': text += '\r'; break;
+    case 't': text += '\t'; break;
+    default: return false;
+    }
+  }
+  return true;
+}
+
+void escape(string const &text, string &out) {
+  for(size_t i = 0; i < text.size(); ++i) {
+    switch(text[i]) {
+    case '\\': out += "\\\\"; break;
+    case '\n': out += "\\n"; break;
+    case '\r': out += "\\r"; break;
+    case '\t': out += "\\t"; break;
+    default: out += text[i]; break;
+    }
+  }
+}
+}
+
+unsigned long long image_hash(unsigned char const *image, unsigned width, unsigned height, unsigned stride) {
+  unsigned long long const prime = 1099511628211ULL;
+  unsigned long long hash = 14695981039346656037ULL;
+  unsigned const size[] = { width, height };
+  for(size_t i = 0; i < sizeof(size); ++i) {
+    hash = (hash ^ reinterpret_cast<unsigned char const*>(size)[i]) * prime;
+  }
+  for(unsigned y = 0; y < height; ++y) {
+    unsigned char const *row = image + static_cast<size_t>(y) * stride;
+    for(unsigned x = 0; x < width; ++x) {
+      hash = (hash ^ row[x]) * prime;
+    }
+  }
+  return hash;
+}
+
+struct ocr_journal::impl {
+  impl() : complete_size(-1), file(0x0), failed(false), last_sync(0) {
+    pthread_mutex_init(&lock, 0x0);
+  }
+  ~impl() {
+    pthread_mutex_destroy(&lock);
+  }
+
+  map<journal_key, entry> entries;
+  off_t complete_size; ///< bytes up to the last complete line of the loaded file (-1 if not loaded)
+  FILE *file;
+  bool failed; ///< a result could not be written
+  double last_sync;
+  string line; ///< buffer for record
+  pthread_mutex_t lock;
+};
+
+ocr_journal::ocr_journal()
+  : pimpl(new impl)
+{ }
+
+ocr_journal::~ocr_journal() {
+  close();
+  delete pimpl;
+}
+
+bool ocr_journal::load(std::string const &filename) {
+  pimpl->complete_size = 0;
+  ifstream in(filename.c_str());
+  if(not in) {
+    return errno == ENOENT;
+  }
+  string line;
+  string fields[7];
+  while(getline(in, line)) {
+    if(in.eof()) {
+      break; // cut off
+    }
+    pimpl->complete_size += line.size() + 1;
+    if(line.empty() or line[0] == '#') {
+      continue;
+    }
+    long stream, confidence;
+    unsigned long start_pts;
+    unsigned long long hash;
+    entry e;
+    if(not split_fields(line, fields, 7) or not parse_number(fields[0], stream) or
+       not parse_number(fields[1], start_pts) or not parse_hash(fields[2], hash) or
+       not parse_number(fields[4], confidence) or not unescape(fields[6], e.text)) {
+      continue;
+    }
+    size_t pass = 0;
+    while(pass < 3 and fields[3] != pass_names[pass]) {
+      ++pass;
+    }
+    if(pass == 3) {
+      continue;
+    }
+    e.pass = static_cast<pass_t>(pass);
+    e.confidence = static_cast<int>(confidence);
+    e.failed = fields[5].find('f') != string::npos;
+    e.timed_out = fields[5].find('t') != string::npos;
+    pimpl->entries[journal_key(stream, start_pts, hash)] = e;
+  }
+  return not in.bad();
+}
+
+bool ocr_journal::open(std::string const &filename, bool append) {
+  close();
+  // drop a line that was cut off, it could look like a valid result when more is appended
+  if(append and pimpl->complete_size >= 0 and truncate(filename.c_str(), pimpl->complete_size) != 0 and
+     errno != ENOENT) {
+    return false;
+  }
+  pimpl->file = fopen(filename.c_str(), append ? "a" : "w");
+  if(not pimpl->file) {
+    return false;
+  }
+  if(ftell(pimpl->file) == 0) {
+    fputs(header, pimpl->file);
+  }
+  pimpl->failed = fflush(pimpl->file) != 0;
+  pimpl->last_sync = seconds();
+  return not pimpl->failed;
+}
+
+ocr_journal::entry const *ocr_journal::find(journal_key const &key) const {
+  map<journal_key, entry>::const_iterator const i = pimpl->entries.find(key);
+  return i == pimpl->entries.end() ? 0x0 : &i->second;
+}
+
+size_t ocr_journal::size() const {
+  return pimpl->entries.size();
+}
+
+void ocr_journal::record(journal_key const &key, pass_t pass, ocr_job const &job) {
+  if(not pimpl->file) {
+    return;
+  }
+  char fields[128];
+  snprintf(fields, sizeof(fields), "%d\t%u\t%016llx\t%s\t%d\t%s%s\t", key.stream, key.start_pts, key.hash,
+           pass_names[pass], job.confidence, job.failed ? "f" : "", job.timed_out ? "t" : job.failed ? "" : "-");
+
+  pthread_mutex_lock(&pimpl->lock);
+  string &line = pimpl->line;
+  line = fields;
+  escape(job.text, line);
+  line += '\n';
+  if(fwrite(line.data(), 1, line.size(), pimpl->file) != line.size() or fflush(pimpl->file) != 0) {
+    pimpl->failed = true;
+  }
+  double const now = seconds();
+  if(now - pimpl->last_sync >= sync_interval) {
+    fdatasync(fileno(pimpl->file));
+    pimpl->last_sync = now;
+  }
+  pthread_mutex_unlock(&pimpl->lock);
+}
+
+bool ocr_journal::close() {
+  if(pimpl->file) {
+    if(fclose(pimpl->file) != 0) {
+      pimpl->failed = true;
+    }
+    pimpl->file = 0x0;
+  }
+  return not pimpl->failed;
+}
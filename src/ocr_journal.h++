@@ -0,0 +1,107 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OCR_JOURNAL_HXX
+#define OCR_JOURNAL_HXX
+
+#include <string>
+#include <vector>
+
+#include "ocr.h++"
+
+/// Identifies a line image: the stream, the start of the first subtitle with the image and a hash of the pixels
+struct journal_key {
+  journal_key(int stream, unsigned start_pts, unsigned long long hash)
+    : stream(stream), start_pts(start_pts), hash(hash)
+  { }
+  bool operator<(journal_key const &other) const {
+    if(stream != other.stream) {
+      return stream < other.stream;
+    }
+    if(start_pts != other.start_pts) {
+      return start_pts < other.start_pts;
+    }
+    return hash < other.hash;
+  }
+  int stream;
+  unsigned start_pts;
+  unsigned long long hash;
+};
+
+/// 64 bit FNV-1a hash of the size and the pixels of an image
+unsigned long long image_hash(unsigned char const *image, unsigned width, unsigned height, unsigned stride);
+
+/**
+ * Append-only journal of OCR results (--journal, --resume).  Every result is
+ * a text line that is flushed at once, so a killed conversion can be resumed
+ * with the results recorded so far.  A line that was cut off is ignored.
+ */
+class ocr_journal {
+public:
+  /// The OCR pass that produced a result
+  enum pass_t { pass_ocr, pass_retry, pass_tier };
+  /// A recorded result
+  struct entry {
+    pass_t pass;
+    int confidence;
+    bool failed, timed_out;
+    std::string text;
+  };
+
+  ocr_journal();
+  ~ocr_journal(); ///< calls close
+
+  /// Reads the results of filename (a missing file is empty).  Later results replace earlier ones.
+  bool load(std::string const &filename);
+  /// Opens filename to record results.  It is truncated unless append.  Returns false on error.
+  bool open(std::string const &filename, bool append);
+  /// A loaded result (0x0 if there is none)
+  entry const *find(journal_key const &key) const;
+  size_t size() const; ///< loaded results
+  /// Appends a result and flushes it (thread safe).
+  void record(journal_key const &key, pass_t pass, ocr_job const &job);
+  /// Returns false if a result could not be written.
+  bool close();
+
+private:
+  struct impl;
+  impl *pimpl;
+
+  // noncopyable
+  ocr_journal(ocr_journal const&);
+  ocr_journal &operator=(ocr_journal const&);
+};
+
+/// Records every job finished by ocr_engines::run.  keys has the key of every job of the run.
+class journal_observer : public ocr_observer {
+public:
+  journal_observer(ocr_journal &journal, ocr_journal::pass_t pass, std::vector<journal_key> const &keys)
+    : journal(journal), pass(pass), keys(keys)
+  { }
+  void finished(size_t index, ocr_job const &job) {
+    journal.record(keys[index], pass, job);
+  }
+
+private:
+  ocr_journal &journal;
+  ocr_journal::pass_t pass;
+  std::vector<journal_key> const &keys;
+};
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ocr_preprocess.h++"
+#include "ocr_backend.h++"
+
+// MPlayer stuff
+#include "spudec.h"
+#include "spudec_simd.h"
+
+#include <algorithm>
+using namespace std;
+
+ocr_preprocessor::ocr_preprocessor(unsigned scale, bool binarize)
+  : scale_(max(scale, 1u)), binarize(binarize), width_(0), height_(0), stride_(0)
+{ }
+
+unsigned char const *ocr_preprocessor::process(unsigned char const *image, unsigned width, unsigned height,
+                                               unsigned stride) {
+  width_ = width * scale_;
+  height_ = height * scale_;
+  stride_ = width_;
+  if(scale_ == 1 and not binarize) {
+    stride_ = stride;
+    return image;
+  }
+  // bilinear scaling doesn't exceed the maximum, so the smaller image is searched
+  unsigned char max_value = 0;
+  if(binarize) {
+    for(unsigned y = 0; y < height; ++y) {
+      unsigned char const *row = image + y*stride;
+      max_value = max(max_value, *max_element(row, row + width));
+    }
+  }
+  buffer.resize(static_cast<size_t>(width_) * height_);
+  unsigned char const *src = image;
+  unsigned src_stride = stride;
+  if(scale_ > 1) {
+    tables.resize(spudec_scale_tables_size(width_, height_));
+    spudec_scale_gray(image, stride, width, height, &buffer[0], width_, width_, height_, &tables[0]);
+    src = &buffer[0];
+    src_stride = width_;
+  }
+  if(binarize) {
+    // in place if the image was scaled
+    spudec_binarize(src, src_stride, &buffer[0], width_, width_, height_, max_value / 2);
+  }
+  return &buffer[0];
+}
+
+namespace {
+/// Preprocesses the images and maps positions back to the original image
+struct preprocess_backend : public ocr_backend {
+  preprocess_backend(ocr_backend *engine, unsigned scale, bool binarize)
+    : engine(engine), preprocessor(scale, binarize)
+  { }
+
+  ~preprocess_backend() {
+    delete engine;
+  }
+
+  bool init(ocr_config const &config) {
+    return engine->init(config);
+  }
+
+  bool recognize(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                 ocr_result &result) {
+    unsigned char const *processed = preprocessor.process(image, width, height, stride);
+    if(not engine->recognize(processed, preprocessor.width(), preprocessor.height(), preprocessor.stride(), result)) {
+      return false;
+    }
+    unsigned const scale = preprocessor.scale();
+    for(size_t i = 0; i < result.symbols.size(); ++i) {
+      result.symbols[i].left /= scale;
+      result.symbols[i].right = (result.symbols[i].right + scale - 1) / scale;
+    }
+    return true;
+  }
+
+  bool recognize_lines(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                       std::vector<ocr_line> &lines) {
+    unsigned char const *processed = preprocessor.process(image, width, height, stride);
+    if(not engine->recognize_lines(processed, preprocessor.width(), preprocessor.height(), preprocessor.stride(),
+                                   lines)) {
+      return false;
+    }
+    unsigned const scale = preprocessor.scale();
+    for(size_t i = 0; i < lines.size(); ++i) {
+      lines[i].top /= scale;
+      lines[i].bottom = (lines[i].bottom + scale - 1) / scale;
+    }
+    return true;
+  }
+
+  void shutdown() {
+    engine->shutdown();
+  }
+
+  bool concurrent() const {
+    return engine->concurrent();
+  }
+
+  ocr_backend *engine;
+  ocr_preprocessor preprocessor;
+};
+}
+
+ocr_backend *create_preprocess_backend(ocr_backend *engine, unsigned scale, bool binarize) {
+  return new preprocess_backend(engine, scale, binarize);
+}
@@ -0,0 +1,54 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OCR_PREPROCESS_HXX
+#define OCR_PREPROCESS_HXX
+
+#include <vector>
+
+class ocr_backend;
+
+/**
+ * Prepares images for the OCR: upscales them with the bilinear scaler of
+ * spudec and binarizes them at half their brightest value.  Small DVD
+ * glyphs are recognized better at a larger size.  The buffers are reused,
+ * so an instance should not be shared by several threads.
+ */
+class ocr_preprocessor {
+public:
+  ocr_preprocessor(unsigned scale, bool binarize);
+
+  /// Returns the processed image (valid until the next call)
+  unsigned char const *process(unsigned char const *image, unsigned width, unsigned height, unsigned stride);
+  unsigned width() const { return width_; }
+  unsigned height() const { return height_; }
+  unsigned stride() const { return stride_; }
+  unsigned scale() const { return scale_; }
+
+private:
+  unsigned scale_;
+  bool binarize;
+  unsigned width_, height_, stride_;
+  std::vector<unsigned char> buffer, tables;
+};
+
+/// Wraps engine (and takes ownership of it): images are preprocessed before the OCR.
+ocr_backend *create_preprocess_backend(ocr_backend *engine, unsigned scale, bool binarize);
+
+#endif
@@ -0,0 +1,76 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "output_buffer.h++"
+
+output_buffer::output_buffer(FILE *file, size_t capacity)
+  : file(file), begin(new char[capacity]), pos(begin), last(begin + capacity)
+{ }
+
+output_buffer::~output_buffer() {
+  flush();
+  delete[] begin;
+}
+
+bool output_buffer::flush() {
+  if(pos != begin) {
+    fwrite(begin, 1, pos - begin, file);
+    pos = begin;
+  }
+  return not ferror(file);
+}
+
+void output_buffer::append_slow(char const *str, size_t length) {
+  flush();
+  if(length >= size_t(last - begin)) {
+    fwrite(str, 1, length, file);
+  }
+  else {
+    std::memcpy(pos, str, length);
+    pos += length;
+  }
+}
+
+void output_buffer::number(unsigned value) {
+  char digits[sizeof("4294967295")];
+  char *first = digits + sizeof(digits);
+  do {
+    *--first = char('0' + value % 10);
+    value /= 10;
+  } while(value);
+  append(first, digits + sizeof(digits) - first);
+}
+
+void output_buffer::timestamp(unsigned pts, char separator) {
+  commit(format_timestamp(reserve(timestamp_length), pts, separator));
+}
+
+char *format_timestamp(char *out, unsigned pts, char separator) {
+  unsigned ms = pts / 90;
+  unsigned const s = ms / 1000;
+  ms -= s * 1000;
+  // UINT_MAX pts are about 13 hours so two digits are always enough
+  out = format_digits(out, s / 3600, 2);
+  *out++ = ':';
+  out = format_digits(out, s / 60 % 60, 2);
+  *out++ = ':';
+  out = format_digits(out, s % 60, 2);
+  *out++ = separator;
+  return format_digits(out, ms, 3);
+}
@@ -0,0 +1,105 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUT_BUFFER_HXX
+#define OUTPUT_BUFFER_HXX
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/**
+ * Collects output in a large buffer and writes it to a file in big blocks.
+ * Numbers and time stamps are formatted directly into the buffer without
+ * printf or temporary strings.  The file is not owned.
+ */
+class output_buffer {
+public:
+  enum { default_capacity = 256 * 1024 };
+
+  explicit output_buffer(FILE *file, size_t capacity = default_capacity);
+  ~output_buffer(); ///< flushes
+
+  void put(char c) {
+    if(pos == last) {
+      flush();
+    }
+    *pos++ = c;
+  }
+  void append(char const *str, size_t length) {
+    if(length > size_t(last - pos)) {
+      append_slow(str, length);
+      return;
+    }
+    std::memcpy(pos, str, length);
+    pos += length;
+  }
+  void append(char const *str) {
+    append(str, std::strlen(str));
+  }
+  void append(std::string const &str) {
+    append(str.data(), str.size());
+  }
+  /// Returns room for at least length (<= capacity) bytes.  Call commit with the number of bytes used.
+  char *reserve(size_t length) {
+    if(length > size_t(last - pos)) {
+      flush();
+    }
+    return pos;
+  }
+  void commit(char *end) {
+    pos = end;
+  }
+
+  /// Decimal number
+  void number(unsigned value);
+  /// Time stamp in pts (90 kHz) as HH:MM:SS<separator>mmm
+  void timestamp(unsigned pts, char separator);
+
+  /// Writes the buffered data.  Returns false if the file has an error.
+  bool flush();
+
+private:
+  void append_slow(char const *str, size_t length);
+
+  FILE *file;
+  char *begin;
+  char *pos;
+  char *last;
+
+  // noncopyable
+  output_buffer(output_buffer const&);
+  output_buffer &operator=(output_buffer const&);
+};
+
+/// Writes value as exactly width decimal digits (zero padded, higher digits are cut).  Returns the end.
+inline char *format_digits(char *out, unsigned value, unsigned width) {
+  for(unsigned i = width; i > 0; --i) {
+    out[i-1] = char('0' + value % 10);
+    value /= 10;
+  }
+  return out + width;
+}
+
+enum { timestamp_length = sizeof("HH:MM:SS,mmm") - 1 };
+
+/// Writes pts (90 kHz) as HH:MM:SS<separator>mmm (timestamp_length bytes, no '\0').  Returns the end.
+char *format_timestamp(char *out, unsigned pts, char separator);
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "spu_encoder.h++"
+
+using namespace std;
+
+namespace {
+/// Deterministic pseudo random numbers
+struct lcg {
+  explicit lcg(unsigned seed) : state(seed) { }
+  unsigned next(unsigned range) {
+    state = state * 1103515245u + 12345u;
+    return (state >> 16) % range;
+  }
+  unsigned state;
+};
+
+void fill(spu_bitmap &bitmap, unsigned x, unsigned y, unsigned w, unsigned h) {
+  for(unsigned j = y; j < y + h and j < bitmap.height; ++j) {
+    for(unsigned i = x; i < x + w and i < bitmap.width; ++i) {
+      bitmap.pixels[j * bitmap.width + i] = 1;
+    }
+  }
+}
+
+/// Draws the outline (2) around the text (1)
+void outline(spu_bitmap &bitmap) {
+  unsigned const w = bitmap.width, h = bitmap.height;
+  vector<unsigned char> &p = bitmap.pixels;
+  for(unsigned y = 0; y < h; ++y) {
+    for(unsigned x = 0; x < w; ++x) {
+      if(p[y * w + x] == 0 and ((x > 0 and p[y * w + x - 1] == 1) or (x + 1 < w and p[y * w + x + 1] == 1) or
+                                (y > 0 and p[(y - 1) * w + x] == 1) or (y + 1 < h and p[(y + 1) * w + x] == 1))) {
+        p[y * w + x] = 2;
+      }
+    }
+  }
+}
+
+/// 5x7 font for ' ' to '~', one byte per column, the lowest bit is the top row
+unsigned char const font[][5] = {
+  {0x00,0x00,0x00,0x00,0x00}, {0x00,0x00,0x5f,0x00,0x00}, {0x00,0x07,0x00,0x07,0x00}, {0x14,0x7f,0x14,0x7f,0x14},
+  {0x24,0x2a,0x7f,0x2a,0x12}, {0x23,0x13,0x08,0x64,0x62}, {0x36,0x49,0x55,0x22,0x50}, {0x00,0x05,0x03,0x00,0x00},
+  {0x00,0x1c,0x22,0x41,0x00}, {0x00,0x41,0x22,0x1c,0x00}, {0x14,0x08,0x3e,0x08,0x14}, {0x08,0x08,0x3e,0x08,0x08},
+  {0x00,0x50,0x30,0x00,0x00}, {0x08,0x08,0x08,0x08,0x08}, {0x00,0x60,0x60,0x00,0x00}, {0x20,0x10,0x08,0x04,0x02},
+  {0x3e,0x51,0x49,0x45,0x3e}, {0x00,0x42,0x7f,0x40,0x00}, {0x42,0x61,0x51,0x49,0x46}, {0x21,0x41,0x45,0x4b,0x31},
+  {0x18,0x14,0x12,0x7f,0x10}, {0x27,0x45,0x45,0x45,0x39}, {0x3c,0x4a,0x49,0x49,0x30}, {0x01,0x71,0x09,0x05,0x03},
+  {0x36,0x49,0x49,0x49,0x36}, {0x06,0x49,0x49,0x29,0x1e}, {0x00,0x36,0x36,0x00,0x00}, {0x00,0x56,0x36,0x00,0x00},
+  {0x08,0x14,0x22,0x41,0x00}, {0x14,0x14,0x14,0x14,0x14}, {0x00,0x41,0x22,0x14,0x08}, {0x02,0x01,0x51,0x09,0x06},
+  {0x32,0x49,0x79,0x41,0x3e}, {0x7e,0x11,0x11,0x11,0x7e}, {0x7f,0x49,0x49,0x49,0x36}, {0x3e,0x41,0x41,0x41,0x22},
+  {0x7f,0x41,0x41,0x22,0x1c}, {0x7f,0x49,0x49,0x49,0x41}, {0x7f,0x09,0x09,0x09,0x01}, {0x3e,0x41,0x49,0x49,0x7a},
+  {0x7f,0x08,0x08,0x08,0x7f}, {0x00,0x41,0x7f,0x41,0x00}, {0x20,0x40,0x41,0x3f,0x01}, {0x7f,0x08,0x14,0x22,0x41},
+  {0x7f,0x40,0x40,0x40,0x40}, {0x7f,0x02,0x0c,0x02,0x7f}, {0x7f,0x04,0x08,0x10,0x7f}, {0x3e,0x41,0x41,0x41,0x3e},
+  {0x7f,0x09,0x09,0x09,0x06}, {0x3e,0x41,0x51,0x21,0x5e}, {0x7f,0x09,0x19,0x29,0x46}, {0x46,0x49,0x49,0x49,0x31},
+  {0x01,0x01,0x7f,0x01,0x01}, {0x3f,0x40,0x40,0x40,0x3f}, {0x1f,0x20,0x40,0x20,0x1f}, {0x3f,0x40,0x38,0x40,0x3f},
+  {0x63,0x14,0x08,0x14,0x63}, {0x07,0x08,0x70,0x08,0x07}, {0x61,0x51,0x49,0x45,0x43}, {0x00,0x7f,0x41,0x41,0x00},
+  {0x02,0x04,0x08,0x10,0x20}, {0x00,0x41,0x41,0x7f,0x00}, {0x04,0x02,0x01,0x02,0x04}, {0x40,0x40,0x40,0x40,0x40},
+  {0x00,0x01,0x02,0x04,0x00}, {0x20,0x54,0x54,0x54,0x78}, {0x7f,0x48,0x44,0x44,0x38}, {0x38,0x44,0x44,0x44,0x20},
+  {0x38,0x44,0x44,0x48,0x7f}, {0x38,0x54,0x54,0x54,0x18}, {0x08,0x7e,0x09,0x01,0x02}, {0x0c,0x52,0x52,0x52,0x3e},
+  {0x7f,0x08,0x04,0x04,0x78}, {0x00,0x44,0x7d,0x40,0x00}, {0x20,0x40,0x44,0x3d,0x00}, {0x7f,0x10,0x28,0x44,0x00},
+  {0x00,0x41,0x7f,0x40,0x00}, {0x7c,0x04,0x18,0x04,0x78}, {0x7c,0x08,0x04,0x04,0x78}, {0x38,0x44,0x44,0x44,0x38},
+  {0x7c,0x14,0x14,0x14,0x08}, {0x08,0x14,0x14,0x18,0x7c}, {0x7c,0x08,0x04,0x04,0x08}, {0x48,0x54,0x54,0x54,0x20},
+  {0x04,0x3f,0x44,0x40,0x20}, {0x3c,0x40,0x40,0x20,0x7c}, {0x1c,0x20,0x40,0x20,0x1c}, {0x3c,0x40,0x30,0x40,0x3c},
+  {0x44,0x28,0x10,0x28,0x44}, {0x0c,0x50,0x50,0x50,0x3c}, {0x44,0x64,0x54,0x4c,0x44}, {0x00,0x08,0x36,0x41,0x00},
+  {0x00,0x00,0x7f,0x00,0x00}, {0x00,0x41,0x36,0x08,0x00}, {0x08,0x04,0x08,0x10,0x08}
+};
+
+/// Columns and rows of a character cell (the glyph and the space to the next one)
+unsigned const cell_width = 6, cell_height = 9;
+
+void draw_char(spu_bitmap &bitmap, unsigned x, unsigned y, char c, unsigned scale) {
+  unsigned const index = c >= ' ' and c <= '~' ? c - ' ' : '?' - ' ';
+  for(unsigned column = 0; column < 5; ++column) {
+    for(unsigned row = 0; row < 7; ++row) {
+      if(font[index][column] & (1 << row)) {
+        fill(bitmap, x + column * scale, y + row * scale, scale, scale);
+      }
+    }
+  }
+}
+
+/// Appends nibbles to a byte vector, the RLE data of an SPU packet
+struct nibble_writer {
+  explicit nibble_writer(vector<unsigned char> &out) : out(out), half(false) { }
+  void put(unsigned nibble) {
+    if(half) {
+      out.back() |= nibble;
+    }
+    else {
+      out.push_back(nibble << 4);
+    }
+    half = not half;
+  }
+  /// The lowest count nibbles of value
+  void put(unsigned value, unsigned count) {
+    while(count--) {
+      put((value >> 4 * count) & 0xf);
+    }
+  }
+  /// Lines start on a byte boundary
+  void align() {
+    half = false;
+  }
+  vector<unsigned char> &out;
+  bool half;
+};
+
+/// RLE encodes line y.  The decoder maps the color code c to index 3 - c.
+void encode_line(nibble_writer &out, spu_bitmap const &bitmap, unsigned y) {
+  unsigned char const *const line = &bitmap.pixels[y * bitmap.width];
+  for(unsigned x = 0; x < bitmap.width; ) {
+    unsigned run = 1;
+    while(x + run < bitmap.width and line[x + run] == line[x]) {
+      ++run;
+    }
+    unsigned const code = 3 - (line[x] & 3);
+    x += run;
+    if(x == bitmap.width) { // a run of 0: until the end of the line
+      out.put(code, 4);
+      break;
+    }
+    while(run > 0) {
+      unsigned const len = run < 255 ? run : 255;
+      out.put(len << 2 | code, len < 4 ? 1 : len < 16 ? 2 : len < 64 ? 3 : 4);
+      run -= len;
+    }
+  }
+  out.align();
+}
+
+void put_be16(vector<unsigned char> &out, size_t at, unsigned value) {
+  out[at] = value >> 8;
+  out[at + 1] = value & 0xff;
+}
+}
+
+void render_glyphs(spu_bitmap &bitmap, unsigned lines, unsigned seed) {
+  lcg random(seed);
+  unsigned const line_height = bitmap.height / lines;
+  for(unsigned line = 0; line < lines; ++line) {
+    unsigned const top = line * line_height + 4, bottom = (line + 1) * line_height - 4;
+    unsigned x = 16 + random.next(bitmap.width / 4);
+    while(x + 32 < bitmap.width) {
+      unsigned const glyph_width = 6 + random.next(8);
+      unsigned const bar = top + random.next(bottom - top - 2);
+      fill(bitmap, x, top, 2, bottom - top);
+      if(random.next(3)) {
+        fill(bitmap, x + glyph_width - 2, top + random.next(4), 2, bottom - top - 4);
+      }
+      fill(bitmap, x, bar, glyph_width, 2);
+      x += glyph_width + 3 + (random.next(5) ? 0 : 8);
+    }
+  }
+  outline(bitmap);
+}
+
+unsigned text_width(std::string const &line, unsigned scale) {
+  return line.empty() ? 0 : (line.size() * cell_width - 1) * scale;
+}
+
+spu_bitmap render_text(std::vector<std::string> const &lines, unsigned scale) {
+  unsigned width = 0;
+  for(size_t i = 0; i < lines.size(); ++i) {
+    unsigned const w = text_width(lines[i], scale);
+    width = w > width ? w : width;
+  }
+  unsigned const margin = scale; // room for the outline
+  spu_bitmap bitmap(width + 2 * margin, lines.size() * cell_height * scale + 2 * margin);
+  for(size_t i = 0; i < lines.size(); ++i) {
+    unsigned const x = margin + (width - text_width(lines[i], scale)) / 2;
+    unsigned const y = margin + i * cell_height * scale;
+    for(size_t c = 0; c < lines[i].size(); ++c) {
+      draw_char(bitmap, x + c * cell_width * scale, y, lines[i][c], scale);
+    }
+  }
+  outline(bitmap);
+  return bitmap;
+}
+
+void encode_spu(spu_bitmap const &bitmap, unsigned x, unsigned y, unsigned duration,
+                std::vector<unsigned char> &packet) {
+  packet.assign(4, 0); // size and offset of the control sequences
+  nibble_writer nibbles(packet);
+  size_t const top_field = packet.size();
+  for(unsigned line = 0; line < bitmap.height; line += 2) {
+    encode_line(nibbles, bitmap, line);
+  }
+  size_t const bottom_field = packet.size();
+  for(unsigned line = 1; line < bitmap.height; line += 2) {
+    encode_line(nibbles, bitmap, line);
+  }
+
+  size_t const first = packet.size();
+  unsigned const x1 = x + bitmap.width - 1, y1 = y + bitmap.height;
+  unsigned char const show[] = {
+    0, 0, 0, 0, // date, next
+    0x03, 0x01, 0x23, // palette: indices 0-3 use colors 0-3
+    0x04, 0x0f, 0xff, // alpha: 0 is transparent
+    0x05, static_cast<unsigned char>(x >> 4), static_cast<unsigned char>((x & 0xf) << 4 | x1 >> 8),
+    static_cast<unsigned char>(x1 & 0xff), static_cast<unsigned char>(y >> 4),
+    static_cast<unsigned char>((y & 0xf) << 4 | y1 >> 8), static_cast<unsigned char>(y1 & 0xff),
+    0x06, static_cast<unsigned char>(top_field >> 8), static_cast<unsigned char>(top_field & 0xff),
+    static_cast<unsigned char>(bottom_field >> 8), static_cast<unsigned char>(bottom_field & 0xff),
+    0x01, // start display
+    0xff
+  };
+  packet.insert(packet.end(), show, show + sizeof(show));
+  size_t const second = packet.size();
+  unsigned char const hide[] = { 0, 0, 0, 0, 0x02 /* stop display */, 0xff };
+  packet.insert(packet.end(), hide, hide + sizeof(hide));
+  put_be16(packet, first + 2, second);
+  put_be16(packet, second, duration / 1024);
+  put_be16(packet, second + 2, second); // the last sequence points to itself
+  put_be16(packet, 0, packet.size());
+  put_be16(packet, 2, first);
+}
@@ -0,0 +1,66 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPU_ENCODER_HXX
+#define SPU_ENCODER_HXX
+
+#include <string>
+#include <vector>
+
+/// A subpicture of palette indices: 0 background, 1 text, 2 outline (3 is unused)
+struct spu_bitmap {
+  explicit spu_bitmap(unsigned width = 0, unsigned height = 0)
+    : width(width), height(height), pixels(width * height)
+  { }
+  unsigned width, height;
+  std::vector<unsigned char> pixels;
+};
+
+/**
+ * Fills the bitmap with lines of random glyph-like strokes and their outline,
+ * about what the RLE decoder produces for real subtitles.  The same seed
+ * gives the same bitmap.
+ */
+void render_glyphs(spu_bitmap &bitmap, unsigned lines, unsigned seed);
+
+/// Width in pixels of line rendered by render_text
+unsigned text_width(std::string const &line, unsigned scale);
+
+/**
+ * Renders the lines of text (centered) with a built-in 5x7 pixel font,
+ * scaled by scale, and an outline.  Characters outside of printable ASCII
+ * are drawn as '?'.
+ */
+spu_bitmap render_text(std::vector<std::string> const &lines, unsigned scale);
+
+/// The duration (90 kHz) encode_spu stores: SPU control sequences count in 1024 ticks
+inline unsigned spu_duration(unsigned duration) {
+  return duration / 1024 * 1024;
+}
+
+/**
+ * RLE encodes bitmap as an SPU packet, shown at x, y of the frame for
+ * duration (90 kHz).  Indices 0-3 use the colors 0-3 of the .idx palette,
+ * index 0 is transparent.  The packet must not exceed 65535 bytes (its
+ * size field is 16 bits), the caller checks packet.size().
+ */
+void encode_spu(spu_bitmap const &bitmap, unsigned x, unsigned y, unsigned duration,
+                std::vector<unsigned char> &packet);
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "srt_reader.h++"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+using namespace std;
+
+namespace {
+bool start_before(srt_cue const &a, srt_cue const &b) {
+  return a.start_ms < b.start_ms;
+}
+
+void strip_cr(string &line) {
+  if(not line.empty() and line[line.size() - 1] == '\r') {
+    line.resize(line.size() - 1);
+  }
+}
+
+/// Parses "HH:MM:SS,mmm --> HH:MM:SS,mmm" (a '.' is accepted as well)
+bool parse_times(string const &line, srt_cue &cue) {
+  unsigned h1, m1, s1, ms1, h2, m2, s2, ms2;
+  char sep1, sep2;
+  if(sscanf(line.c_str(), "%u:%u:%u%c%u --> %u:%u:%u%c%u",
+            &h1, &m1, &s1, &sep1, &ms1, &h2, &m2, &s2, &sep2, &ms2) != 10) {
+    return false;
+  }
+  cue.start_ms = ((h1*60 + m1)*60 + s1)*1000 + ms1;
+  cue.end_ms = ((h2*60 + m2)*60 + s2)*1000 + ms2;
+  return true;
+}
+}
+
+bool read_srt(char const *filename, vector<srt_cue> &cues) {
+  ifstream in(filename);
+  if(not in) {
+    return false;
+  }
+  cues.clear();
+  string line;
+  bool in_cue = false;
+  while(getline(in, line)) {
+    strip_cr(line);
+    if(cues.empty() and line.compare(0, 3, "\xef\xbb\xbf") == 0) { // UTF-8 BOM
+      line.erase(0, 3);
+    }
+    if(line.empty()) {
+      in_cue = false;
+    }
+    else if(in_cue) {
+      srt_cue &cue = cues.back();
+      if(not cue.text.empty()) {
+        cue.text += '\n';
+      }
+      cue.text += line;
+    }
+    else if(line.find("-->") != string::npos) { // the number before is ignored
+      srt_cue cue;
+      if(parse_times(line, cue)) {
+        cues.push_back(cue);
+        in_cue = true;
+      }
+    }
+  }
+  stable_sort(cues.begin(), cues.end(), start_before);
+  return true;
+}
+
+srt_cue const *find_srt_cue(vector<srt_cue> const &cues, unsigned start_ms, unsigned tolerance_ms) {
+  srt_cue key;
+  key.start_ms = start_ms;
+  vector<srt_cue>::const_iterator const after = lower_bound(cues.begin(), cues.end(), key, start_before);
+  srt_cue const *best = 0x0;
+  unsigned best_distance = tolerance_ms + 1;
+  if(after != cues.end() and after->start_ms - start_ms < best_distance) {
+    best = &*after;
+    best_distance = after->start_ms - start_ms;
+  }
+  if(after != cues.begin() and start_ms - (after - 1)->start_ms < best_distance) {
+    best = &*(after - 1);
+  }
+  return best;
+}
+
+double text_similarity(string const &a, string const &b) {
+  if(a.empty() and b.empty()) {
+    return 1.0;
+  }
+  // Levenshtein distance with a single row
+  vector<size_t> row(b.size() + 1);
+  for(size_t j = 0; j <= b.size(); ++j) {
+    row[j] = j;
+  }
+  for(size_t i = 1; i <= a.size(); ++i) {
+    size_t diagonal = row[0];
+    row[0] = i;
+    for(size_t j = 1; j <= b.size(); ++j) {
+      size_t const above = row[j];
+      row[j] = min(min(row[j] + 1, row[j - 1] + 1), diagonal + (a[i - 1] != b[j - 1]));
+      diagonal = above;
+    }
+  }
+  return 1.0 - static_cast<double>(row[b.size()]) / max(a.size(), b.size());
+}
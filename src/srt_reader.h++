@@ -0,0 +1,42 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRT_READER_HXX
+#define SRT_READER_HXX
+
+#include <string>
+#include <vector>
+
+/// A cue of an .srt file
+struct srt_cue {
+  srt_cue() : start_ms(0), end_ms(0) { }
+  unsigned start_ms, end_ms;
+  std::string text; ///< lines separated by '\n'
+};
+
+/// Reads the cues of an .srt file sorted by start time.  Returns false if the file can't be read.
+bool read_srt(char const *filename, std::vector<srt_cue> &cues);
+
+/// Finds the cue starting closest to start_ms, at most tolerance_ms away.  Returns 0x0 if there is none.
+srt_cue const *find_srt_cue(std::vector<srt_cue> const &cues, unsigned start_ms, unsigned tolerance_ms);
+
+/// Similarity of two texts from 0 (nothing in common) to 1 (equal), based on the edit distance
+double text_similarity(std::string const &a, std::string const &b);
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stats.h++"
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <time.h>
+
+using namespace std;
+
+namespace {
+char const *const stage_names[] = { "open", "decode", "split", "ocr", "write" };
+
+double ns2s(uint64_t ns) {
+  return ns * 1e-9;
+}
+
+/// Nearest-rank percentile of sorted values (0 if empty)
+double percentile(vector<double> const &sorted, double p) {
+  if(sorted.empty()) {
+    return 0;
+  }
+  size_t rank = static_cast<size_t>(p / 100 * sorted.size() + 0.999999);
+  rank = min(max(rank, size_t(1)), sorted.size());
+  return sorted[rank - 1];
+}
+
+double const percentiles[] = { 50, 90, 99, 100 };
+size_t const percentile_count = sizeof(percentiles)/sizeof(percentiles[0]);
+
+/// Formats a floating point number without locale or stream state
+string number(double value, char const *format = "%.6f") {
+  char buf[64];
+  snprintf(buf, sizeof(buf), format, value);
+  return buf;
+}
+}
+
+double seconds() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+run_stats::run_stats()
+  : demux(), decode(), cues(0), too_small(0), lines(0), images(0), resumed(0), ocr_calls(0), ocr_failures(0),
+    timed_out(0), timeout_recovered(0)
+{
+  fill(stage_seconds, stage_seconds + stage_count, 0.0);
+  fill(started, started + stage_count, 0.0);
+}
+
+void run_stats::print(std::ostream &out) const {
+  double total = 0;
+  for(size_t i = 0; i < stage_count; ++i) {
+    total += stage_seconds[i];
+  }
+  out << "Stats (seconds):\n"
+      << "  open      " << number(stage_seconds[stage_open], "%10.4f") << "\n"
+      << "    .idx    " << number(ns2s(demux.idx_ns), "%10.4f") << "  " << demux.idx_lines << " lines\n"
+      << "    mpeg_run" << number(ns2s(demux.mpeg_run_ns), "%10.4f") << "  " << demux.mpeg_packets << " packets, "
+      << demux.spu_packets << " subtitle packets, " << demux.sub_bytes << " bytes\n"
+      << "  decode    " << number(stage_seconds[stage_decode], "%10.4f") << "\n"
+      << "    assemble" << number(ns2s(decode.assemble_ns), "%10.4f") << "  " << decode.fragments << " fragments, "
+      << decode.fragment_bytes << " bytes, " << decode.packets << " packets, " << decode.broken << " broken\n"
+      << "    process " << number(ns2s(decode.process_ns), "%10.4f") << "  " << decode.images << " images, "
+      << decode.pixels << " pixels (all threads)\n"
+      << "    drain   " << number(ns2s(decode.drain_ns), "%10.4f") << "  (decoder threads, wall time)\n"
+      << "  split     " << number(stage_seconds[stage_split], "%10.4f") << "  " << cues << " cues, "
+      << too_small << " too small, " << lines << " lines\n"
+      << "  ocr       " << number(stage_seconds[stage_ocr], "%10.4f") << "  " << images << " images, "
+      << resumed << " resumed, " << ocr_calls << " calls, " << ocr_failures << " failed\n"
+      << "    timeout             " << timed_out << " images, " << timeout_recovered << " recovered, cues:";
+  if(timed_out_cues.empty()) {
+    out << " none";
+  }
+  for(size_t i = 0; i < timed_out_cues.size(); ++i) {
+    out << ' ' << timed_out_cues[i];
+  }
+  out << '\n'
+      << "  write     " << number(stage_seconds[stage_write], "%10.4f") << "\n"
+      << "  total     " << number(total, "%10.4f") << "\n";
+
+  vector<double> sorted(cue_seconds);
+  sort(sorted.begin(), sorted.end());
+  out << "  OCR time per cue (ms):";
+  for(size_t i = 0; i < percentile_count; ++i) {
+    out << (i ? ", " : " ") << (percentiles[i] == 100 ? string("max") : "p" + number(percentiles[i], "%.0f"))
+        << ' ' << number(percentile(sorted, percentiles[i]) * 1000, "%.2f");
+  }
+  out << '\n';
+}
+
+void run_stats::print_json(std::ostream &out) const {
+  out << "{\n  \"stages\": {";
+  for(size_t i = 0; i < stage_count; ++i) {
+    out << (i ? ", " : " ") << '"' << stage_names[i] << "\": " << number(stage_seconds[i]);
+  }
+  out << " },\n"
+      << "  \"vobsub_open\": { \"idx_seconds\": " << number(ns2s(demux.idx_ns))
+      << ", \"idx_lines\": " << demux.idx_lines
+      << ", \"mpeg_run_seconds\": " << number(ns2s(demux.mpeg_run_ns))
+      << ", \"mpeg_packets\": " << demux.mpeg_packets
+      << ", \"subtitle_packets\": " << demux.spu_packets
+      << ", \"sub_bytes\": " << demux.sub_bytes << " },\n"
+      << "  \"spudec_assemble\": { \"seconds\": " << number(ns2s(decode.assemble_ns))
+      << ", \"fragments\": " << decode.fragments
+      << ", \"bytes\": " << decode.fragment_bytes
+      << ", \"packets\": " << decode.packets
+      << ", \"broken\": " << decode.broken << " },\n"
+      << "  \"spudec_process_data\": { \"seconds\": " << number(ns2s(decode.process_ns))
+      << ", \"images\": " << decode.images
+      << ", \"pixels\": " << decode.pixels
+      << ", \"drain_seconds\": " << number(ns2s(decode.drain_ns)) << " },\n"
+      << "  \"cues\": " << cues << ",\n"
+      << "  \"too_small\": " << too_small << ",\n"
+      << "  \"lines\": " << lines << ",\n"
+      << "  \"ocr\": { \"images\": " << images
+      << ", \"resumed\": " << resumed
+      << ", \"calls\": " << ocr_calls
+      << ", \"failed\": " << ocr_failures
+      << ", \"timed_out\": " << timed_out
+      << ", \"timeout_recovered\": " << timeout_recovered
+      << ", \"timed_out_cues\": [";
+  for(size_t i = 0; i < timed_out_cues.size(); ++i) {
+    out << (i ? ", " : "") << timed_out_cues[i];
+  }
+  out << "] },\n";
+
+  vector<double> sorted(cue_seconds);
+  sort(sorted.begin(), sorted.end());
+  out << "  \"cue_ocr_seconds\": {";
+  for(size_t i = 0; i < percentile_count; ++i) {
+    out << (i ? ", " : " ") << '"' << (percentiles[i] == 100 ? string("max") : "p" + number(percentiles[i], "%.0f"))
+        << "\": " << number(percentile(sorted, percentiles[i]));
+  }
+  out << " }\n}\n";
+}
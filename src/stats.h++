@@ -0,0 +1,73 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATS_HXX
+#define STATS_HXX
+
+#include <iosfwd>
+#include <vector>
+
+#include "vobsub.h"
+#include "spudec.h"
+
+/// Monotonic clock (CLOCK_MONOTONIC) in seconds
+double seconds();
+
+/**
+ * Timing and counters of a conversion (--stats).  The stages are timed with
+ * begin/end, the decoder statistics are copied from vobsub_get_stats and
+ * spudec_get_decode_stats.
+ */
+struct run_stats {
+  enum stage_t { stage_open, stage_decode, stage_split, stage_ocr, stage_write, stage_count };
+
+  run_stats();
+
+  void begin(stage_t stage) {
+    started[stage] = seconds();
+  }
+  void end(stage_t stage) {
+    stage_seconds[stage] += seconds() - started[stage];
+  }
+
+  /// Text summary
+  void print(std::ostream &out) const;
+  /// The same as a JSON object
+  void print_json(std::ostream &out) const;
+
+  double stage_seconds[stage_count];
+  vobsub_stats_t demux;
+  spudec_decode_stats_t decode;
+  unsigned long cues;
+  unsigned long too_small; ///< images skipped by --min-width/--min-height
+  unsigned long lines;
+  unsigned long images; ///< OCR images (without the lines reusing a text)
+  unsigned long resumed; ///< images taken from the journal
+  unsigned long ocr_calls;
+  unsigned long ocr_failures; ///< images without text after all OCR passes
+  unsigned long timed_out; ///< images cancelled by --ocr-timeout
+  unsigned long timeout_recovered; ///< of those, recognized again with a simpler page layout
+  std::vector<unsigned> timed_out_cues; ///< numbers (from 1) of the cues with a timed out image
+  std::vector<double> cue_seconds; ///< OCR time of every cue
+
+private:
+  double started[stage_count];
+};
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "subtitle_writer.h++"
+
+#include <cstring>
+
+namespace {
+/// Appends text replacing every character in special with the matching entry of replacement
+void append_escaped(output_buffer &out, std::string const &text, char const *special,
+                    char const *const *replacement) {
+  size_t run = 0;
+  for(size_t i = 0; i < text.size(); ++i) {
+    char const *found = text[i] ? std::strchr(special, text[i]) : 0x0;
+    if(found) {
+      out.append(text.data() + run, i - run);
+      out.append(replacement[found - special]);
+      run = i + 1;
+    }
+  }
+  out.append(text.data() + run, text.size() - run);
+}
+
+struct srt_writer : public subtitle_writer {
+  explicit srt_writer(output_buffer &out) : subtitle_writer(out) { }
+
+  void write(unsigned number, unsigned start_pts, unsigned end_pts, std::string const &text) {
+    out.number(number);
+    out.put('\n');
+    out.timestamp(start_pts, ',');
+    out.append(" --> ", 5);
+    out.timestamp(end_pts, ',');
+    out.put('\n');
+    out.append(text);
+    out.append("\n\n", 2);
+  }
+};
+
+/// WebVTT: like srt with '.' before the milliseconds, a header and escaped text
+struct vtt_writer : public subtitle_writer {
+  explicit vtt_writer(output_buffer &out) : subtitle_writer(out) { }
+
+  void begin() {
+    out.append("WEBVTT\n\n");
+  }
+
+  void write(unsigned number, unsigned start_pts, unsigned end_pts, std::string const &text) {
+    static char const *const replacement[] = { "&amp;", "&lt;", "&gt;" }; // "-->" ends the cue
+    out.number(number);
+    out.put('\n');
+    out.timestamp(start_pts, '.');
+    out.append(" --> ", 5);
+    out.timestamp(end_pts, '.');
+    out.put('\n');
+    append_escaped(out, text, "&<>", replacement);
+    out.append("\n\n", 2);
+  }
+};
+
+/// Advanced SubStation Alpha with a single default style
+struct ass_writer : public subtitle_writer {
+  explicit ass_writer(output_buffer &out) : subtitle_writer(out) { }
+
+  void begin() {
+    out.append("[Script Info]\n"
+               "ScriptType: v4.00+\n"
+               "WrapStyle: 0\n"
+               "ScaledBorderAndShadow: yes\n"
+               "\n"
+               "[V4+ Styles]\n"
+               "Format: Name, Fontname, Fontsize, PrimaryColour, SecondaryColour, OutlineColour, BackColour, "
+               "Bold, Italic, Underline, StrikeOut, ScaleX, ScaleY, Spacing, Angle, BorderStyle, Outline, "
+               "Shadow, Alignment, MarginL, MarginR, MarginV, Encoding\n"
+               "Style: Default,Arial,20,&H00FFFFFF,&H000000FF,&H00000000,&H00000000,"
+               "0,0,0,0,100,100,0,0,1,2,0,2,10,10,10,1\n"
+               "\n"
+               "[Events]\n"
+               "Format: Layer, Start, End, Style, Name, MarginL, MarginR, MarginV, Effect, Text\n");
+  }
+
+  void write(unsigned, unsigned start_pts, unsigned end_pts, std::string const &text) {
+    // '{' starts an override block, players drop the text up to '}'
+    static char const *const replacement[] = { "\\N", "\\{", "\\}" };
+    out.append("Dialogue: 0,");
+    timestamp(start_pts);
+    out.put(',');
+    timestamp(end_pts);
+    out.append(",Default,,0,0,0,,");
+    append_escaped(out, text, "\n{}", replacement);
+    out.put('\n');
+  }
+
+private:
+  /// H:MM:SS.cc (centiseconds)
+  void timestamp(unsigned pts) {
+    char buf[timestamp_length];
+    format_timestamp(buf, pts, '.');
+    // drop the leading zero of the hours and the last digit of the milliseconds
+    out.append(buf[0] == '0' ? buf + 1 : buf, buf[0] == '0' ? timestamp_length - 2 : timestamp_length - 1);
+  }
+};
+
+/// JSON Lines: one object per cue with the times in milliseconds
+struct jsonl_writer : public subtitle_writer {
+  explicit jsonl_writer(output_buffer &out) : subtitle_writer(out) { }
+
+  void write(unsigned number, unsigned start_pts, unsigned end_pts, std::string const &text) {
+    out.append("{\"index\":");
+    out.number(number);
+    out.append(",\"start_ms\":");
+    out.number(start_pts / 90);
+    out.append(",\"end_ms\":");
+    out.number(end_pts / 90);
+    out.append(",\"text\":\"");
+    size_t run = 0;
+    for(size_t i = 0; i < text.size(); ++i) {
+      unsigned char const c = text[i];
+      if(c >= 0x20 and c != '"' and c != '\\') {
+        continue; // UTF-8 is valid JSON
+      }
+      out.append(text.data() + run, i - run);
+      run = i + 1;
+      switch(c) {
+      case '"': out.append("\\\"", 2); break;
+      case '\\': out.append("\\\\", 2); break;
+      case '\n': out.append("\\n", 2); break;
+      case '\t': out.append("\\t", 2); break;
+      default: {
+        char escape[] = "\\u00XX";
+        static char const hex[] = "0123456789abcdef";
+        escape[4] = hex[c >> 4];
+        escape[5] = hex[c & 0xF];
+        out.append(escape, 6);
+        break;
+      }
+      }
+    }
+    out.append(text.data() + run, text.size() - run);
+    out.append("\"}\n", 3);
+  }
+};
+}
+
+subtitle_writer *create_subtitle_writer(std::string const &format, output_buffer &out) {
+  if(format == "srt") {
+    return new srt_writer(out);
+  }
+  if(format == "vtt") {
+    return new vtt_writer(out);
+  }
+  if(format == "ass") {
+    return new ass_writer(out);
+  }
+  if(format == "jsonl") {
+    return new jsonl_writer(out);
+  }
+  return 0x0;
+}
+
+bool subtitle_format_known(std::string const &format) {
+  return format == "srt" or format == "vtt" or format == "ass" or format == "jsonl";
+}
+
+std::string pts2srt(unsigned pts) {
+  char buf[timestamp_length];
+  return std::string(buf, format_timestamp(buf, pts, ','));
+}
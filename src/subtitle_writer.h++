@@ -0,0 +1,58 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SUBTITLE_WRITER_HXX
+#define SUBTITLE_WRITER_HXX
+
+#include "output_buffer.h++"
+#include <string>
+
+/**
+ * Writes subtitles in a text format.  begin, write for every cue in order
+ * and end are called once each, so several writers can be fed from the
+ * same pass.  The output buffer is not owned and is not flushed by the
+ * writer.
+ */
+class subtitle_writer {
+public:
+  explicit subtitle_writer(output_buffer &out) : out(out) { }
+  virtual ~subtitle_writer() { }
+
+  virtual void begin() { }
+  /// number counts from 1.  Times are pts (90 kHz).  Lines of text are separated by '\n'.
+  virtual void write(unsigned number, unsigned start_pts, unsigned end_pts, std::string const &text) = 0;
+  virtual void end() { }
+
+protected:
+  output_buffer &out;
+};
+
+/// Creates the writer for format (srt, vtt, ass or jsonl).  Returns 0x0 for an unknown format.
+subtitle_writer *create_subtitle_writer(std::string const &format, output_buffer &out);
+/// Whether create_subtitle_writer knows format.  The format is also the file name extension.
+bool subtitle_format_known(std::string const &format);
+
+/** Converts time stamp in pts format to a string containing the time stamp for the srt format
+ *
+ * pts (presentation time stamp) is given with a 90kHz resolution (1/90 ms).
+ * srt expects a time stamp as  HH:MM:SS:MSS.
+ */
+std::string pts2srt(unsigned pts);
+
+#endif
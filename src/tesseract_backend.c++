@@ -0,0 +1,299 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ocr_backend.h++"
+#include "ocr.h++"
+#include <iostream>
+
+// Tesseract OCR
+#include "tesseract/baseapi.h"
+#ifdef CONFIG_TESSERACT_NAMESPACE
+#include "tesseract/resultiterator.h"
+#include "tesseract/ocrclass.h"
+#endif
+#ifdef CONFIG_LEPTONICA
+#include "leptonica/allheaders.h"
+#endif
+
+#ifdef CONFIG_TESSERACT_NAMESPACE
+using namespace tesseract;
+#endif
+
+namespace {
+#ifdef CONFIG_TESSERACT_NAMESPACE
+/**
+ * Uses SetImage/Recognize instead of TesseractRect.  With Leptonica the
+ * image is copied into a Pix owned by the engine, which is only replaced
+ * when a larger image comes along.  Text, word confidences and (for the
+ * glyph cache) symbols are read from the same recognition pass, the
+ * confidences and symbols with a single result iterator.  The result
+ * vectors keep their capacity from cue to cue.
+ *
+ * Tesseract still allocates per cue: the text returned by GetUTF8Text and
+ * the iterator returned by GetIterator are new objects (the API has no way
+ * to reuse them), and without Leptonica SetImage copies the raw image into
+ * a Pix of its own.
+ */
+struct tesseract_backend : public ocr_backend {
+  tesseract_backend()
+    : symbols(false), timeout_ms(0)
+#ifdef CONFIG_LEPTONICA
+    , pix(0x0), pix_capacity(0)
+#endif
+  { }
+
+  ~tesseract_backend() {
+#ifdef CONFIG_LEPTONICA
+    pixDestroy(&pix);
+#endif
+  }
+
+  bool init(ocr_config const &config) {
+    int ret;
+    switch(config.engine) {
+    case ocr_config::engine_fast:
+      ret = api.Init(config.data_path, config.lang.c_str(), OEM_TESSERACT_ONLY);
+      break;
+    case ocr_config::engine_accurate:
+      // OEM_TESSERACT_LSTM_COMBINED (OEM_TESSERACT_CUBE_COMBINED in tesseract 3)
+      ret = api.Init(config.data_path, config.lang.c_str(), static_cast<OcrEngineMode>(2));
+      break;
+    default:
+      ret = api.Init(config.data_path, config.lang.c_str());
+      break;
+    }
+    if(ret == -1) {
+      return false;
+    }
+    symbols = config.glyph_cache;
+    timeout_ms = config.timeout_ms;
+    if(not config.blacklist.empty()) {
+      api.SetVariable("tessedit_char_blacklist", config.blacklist.c_str());
+    }
+    if(config.layout == ocr_config::layout_line) {
+      api.SetPageSegMode(PSM_SINGLE_LINE);
+    }
+    else if(config.layout == ocr_config::layout_raw_line) {
+      api.SetPageSegMode(PSM_RAW_LINE);
+    }
+    else if(config.layout == ocr_config::layout_block) {
+      api.SetPageSegMode(PSM_SINGLE_BLOCK);
+    }
+    return set_variables(config);
+  }
+
+  bool recognize(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                 ocr_result &result) {
+    set_image(image, width, height, stride);
+    if(not run(result.timed_out)) {
+      return false;
+    }
+    char *text = api.GetUTF8Text();
+    if(not text) {
+      return false;
+    }
+    result.text = text;
+    delete[] text;
+
+    // One pass over the words, or over the symbols for the glyph cache
+    result.word_confidences.clear();
+    result.symbols.clear();
+    int sum = 0;
+    PageIteratorLevel const level = symbols ? RIL_SYMBOL : RIL_WORD;
+    ResultIterator *it = api.GetIterator();
+    if(it) {
+      do {
+        if(it->Empty(level)) {
+          continue;
+        }
+        if(level == RIL_WORD or it->IsAtBeginningOf(RIL_WORD)) {
+          result.word_confidences.push_back(static_cast<int>(it->Confidence(RIL_WORD)));
+          sum += result.word_confidences.back();
+        }
+        if(symbols) {
+          add_symbol(*it, result.symbols);
+        }
+      } while(it->Next(level));
+      delete it;
+    }
+    // same as MeanTextConf, which would collect the confidences again
+    result.confidence = result.word_confidences.empty() ? 0 : sum / static_cast<int>(result.word_confidences.size());
+    return true;
+  }
+
+  bool recognize_lines(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                       std::vector<ocr_line> &lines) {
+    lines.clear();
+    set_image(image, width, height, stride);
+    bool timed_out;
+    if(not run(timed_out)) {
+      return false;
+    }
+    ResultIterator *it = api.GetIterator();
+    if(it) {
+      do {
+        if(it->Empty(RIL_TEXTLINE)) {
+          continue;
+        }
+        int left, top, right, bottom;
+        char *text = it->GetUTF8Text(RIL_TEXTLINE);
+        if(text and it->BoundingBox(RIL_TEXTLINE, &left, &top, &right, &bottom)) {
+          lines.push_back(ocr_line(top, bottom, text, static_cast<int>(it->Confidence(RIL_TEXTLINE))));
+        }
+        delete[] text;
+      } while(it->Next(RIL_TEXTLINE));
+      delete it;
+    }
+    return true;
+  }
+
+  void shutdown() {
+    api.End();
+  }
+
+  bool concurrent() const {
+    return true;
+  }
+
+private:
+  /// Runs the recognition, cancelled by the monitor after timeout_ms
+  bool run(bool &timed_out) {
+    timed_out = false;
+    if(timeout_ms == 0) {
+      return api.Recognize(0x0) == 0;
+    }
+    ETEXT_DESC monitor;
+    monitor.set_deadline_msecs(timeout_ms);
+    if(api.Recognize(&monitor) == 0) {
+      return true;
+    }
+    timed_out = monitor.deadline_exceeded();
+    return false;
+  }
+
+  bool set_variables(ocr_config const &config) {
+    for(size_t i = 0; i < config.variables.size(); ++i) {
+      if(not api.SetVariable(config.variables[i].first.c_str(), config.variables[i].second.c_str())) {
+        std::cerr << "Unknown tesseract variable '" << config.variables[i].first << "'\n";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Appends the symbol at it
+  void add_symbol(ResultIterator const &it, std::vector<ocr_symbol> &result) {
+    int left, top, right, bottom;
+    char *text = it.GetUTF8Text(RIL_SYMBOL);
+    if(text and it.BoundingBox(RIL_SYMBOL, &left, &top, &right, &bottom)) {
+      result.push_back(ocr_symbol(left, right, text, static_cast<int>(it.Confidence(RIL_SYMBOL)),
+                                  it.IsAtBeginningOf(RIL_WORD)));
+    }
+    delete[] text;
+  }
+
+  void set_image(unsigned char const *image, unsigned width, unsigned height, unsigned stride) {
+#ifdef CONFIG_LEPTONICA
+    l_int32 const wpl = (width + 3) / 4;
+    size_t const needed = static_cast<size_t>(wpl) * height;
+    if(not pix or pix_capacity < needed) {
+      pixDestroy(&pix);
+      pix = pixCreateNoInit(width, height, 8);
+      pix_capacity = needed;
+    }
+    else {
+      pixSetWidth(pix, width);
+      pixSetHeight(pix, height);
+      pixSetWpl(pix, wpl);
+    }
+    l_uint32 *line = pixGetData(pix);
+    for(unsigned y = 0; y < height; ++y, line += wpl) {
+      unsigned char const *row = image + y*stride;
+      for(unsigned x = 0; x < width; ++x) {
+        SET_DATA_BYTE(line, x, row[x]);
+      }
+    }
+    api.SetImage(pix);
+#else
+    api.SetImage(image, width, height, 1, stride);
+#endif
+  }
+
+  TessBaseAPI api;
+  bool symbols; ///< fill ocr_result::symbols
+  unsigned timeout_ms;
+#ifdef CONFIG_LEPTONICA
+  Pix *pix;
+  size_t pix_capacity; ///< words available in pix
+#endif
+};
+#else
+/// The old API only has a single static engine, no engine modes, no confidences and no timeouts.
+struct tesseract_backend : public ocr_backend {
+  bool init(ocr_config const &config) {
+    TessBaseAPI::SimpleInit(config.data_path, config.lang.c_str(), false); // TODO params
+    if(not config.blacklist.empty()) {
+      TessBaseAPI::SetVariable("tessedit_char_blacklist", config.blacklist.c_str());
+    }
+    if(config.layout == ocr_config::layout_line) {
+      TessBaseAPI::SetVariable("tessedit_pageseg_mode", "7");
+    }
+    else if(config.layout == ocr_config::layout_raw_line) {
+      TessBaseAPI::SetVariable("tessedit_pageseg_mode", "13");
+    }
+    else if(config.layout == ocr_config::layout_block) {
+      TessBaseAPI::SetVariable("tessedit_pageseg_mode", "6");
+    }
+    for(size_t i = 0; i < config.variables.size(); ++i) {
+      if(not TessBaseAPI::SetVariable(config.variables[i].first.c_str(), config.variables[i].second.c_str())) {
+        std::cerr << "Unknown tesseract variable '" << config.variables[i].first << "'\n";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool recognize(unsigned char const *image, unsigned width, unsigned height, unsigned stride,
+                 ocr_result &result) {
+    char *text = TessBaseAPI::TesseractRect(image, 1, stride, 0, 0, width, height);
+    if(not text) {
+      return false;
+    }
+    result.text = text;
+    delete[] text;
+    result.confidence = -1;
+    result.word_confidences.clear();
+    result.symbols.clear();
+    return true;
+  }
+
+  void shutdown() {
+    TessBaseAPI::End();
+  }
+
+  bool concurrent() const {
+    return false;
+  }
+};
+#endif
+}
+
+ocr_backend *create_tesseract_backend() {
+  return new tesseract_backend;
+}
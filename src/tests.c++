@@ -0,0 +1,399 @@
+/*
+ *  This file is part of vobsub2srt
+ *
+ *  Copyright (C) 2010-2016 Rüdiger Sonderfeld <ruediger@c-plusplus.de>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Tests for vobsub2srt, run by ctest.
+ *
+ *   vobsub2srt-tests [filter]
+ *
+ * runs the tests whose name contains filter (all by default) and exits with
+ * 1 if any of them failed.
+ */
+
+#include "image_dedup.h++"
+#include "spu_encoder.h++"
+#include "subtitle_writer.h++"
+#include "spudec_simd.h"
+#include "spudec.h"
+#include "vobsub.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+
+using namespace std;
+
+namespace {
+/// Deterministic pseudo random numbers, the tests are the same on every run
+struct lcg {
+  explicit lcg(unsigned seed) : state(seed) { }
+  unsigned next(unsigned range) {
+    state = state * 1103515245u + 12345u;
+    return (state >> 16) % range;
+  }
+  unsigned state;
+};
+
+/// Reports a failed check and returns false
+bool fail(char const *what, string const &detail) {
+  fprintf(stderr, "  %s: %s\n", what, detail.c_str());
+  return false;
+}
+
+/// Bytes after the planes that no kernel may touch
+int const guard = 64;
+uint8_t const poison = 0xcd;
+
+/**
+ * pal2gray_alpha4 and spudec_find_bbox at every level spudec_simd_select
+ * accepts against the scalar code, with random palettes, sizes and strides.
+ * The row padding of the source is poisoned (indices pal2gray_alpha4 never
+ * sees, ink spudec_find_bbox must ignore) and the destination planes are
+ * poisoned up to and past dst_stride.
+ */
+bool simd_kernels() {
+  bool ok = true;
+  for(int level = SPUDEC_SIMD_NONE; level <= SPUDEC_SIMD_NEON; ++level) {
+    if(spudec_simd_select(level) != level) {
+      continue;
+    }
+    string const name = spudec_simd_name(level);
+    lcg random(level + 1);
+    for(int i = 0; i < 500 and ok; ++i) {
+      int const w = 1 + random.next(i < 100 ? 80 : 800);
+      int const h = 1 + random.next(40);
+      int const src_stride = w + random.next(48);
+      int const dst_stride = w + random.next(48);
+      uint16_t pal[4];
+      for(int c = 0; c < 4; ++c) {
+        pal[c] = random.next(0x10000);
+      }
+      vector<uint8_t> src(src_stride * h);
+      for(int y = 0; y < h; ++y) {
+        for(int x = 0; x < src_stride; ++x) {
+          src[y * src_stride + x] = x < w ? random.next(4) : 4 + random.next(252);
+        }
+      }
+
+      size_t const plane = dst_stride * h + guard;
+      vector<uint8_t> expected(2 * plane, poison), got(2 * plane, poison);
+      spudec_simd_select(SPUDEC_SIMD_NONE);
+      pal2gray_alpha_c(pal, &src[0], src_stride, &expected[0], &expected[plane], dst_stride, w, h);
+      spudec_simd_select(level);
+      pal2gray_alpha4(pal, &src[0], src_stride, &got[0], &got[plane], dst_stride, w, h);
+      if(got != expected) {
+        char detail[128];
+        snprintf(detail, sizeof(detail), "pal2gray_alpha4 w=%d h=%d src_stride=%d dst_stride=%d", w, h, src_stride, dst_stride);
+        ok = fail(name.c_str(), detail);
+      }
+
+      // A few ink pixels (or none) in the image, ink in the padding
+      vector<uint8_t> alpha(src_stride * h);
+      for(int y = 0; y < h; ++y) {
+        for(int x = w; x < src_stride; ++x) {
+          alpha[y * src_stride + x] = 0xff;
+        }
+      }
+      for(unsigned n = random.next(4); n > 0; --n) {
+        alpha[random.next(h) * src_stride + random.next(w)] = 1 + random.next(255);
+      }
+      int box[2][4];
+      int found[2];
+      spudec_simd_select(SPUDEC_SIMD_NONE);
+      found[0] = spudec_find_bbox(&alpha[0], src_stride, w, h, &box[0][0], &box[0][1], &box[0][2], &box[0][3]);
+      spudec_simd_select(level);
+      found[1] = spudec_find_bbox(&alpha[0], src_stride, w, h, &box[1][0], &box[1][1], &box[1][2], &box[1][3]);
+      if(found[0] != found[1] or (found[0] and memcmp(box[0], box[1], sizeof(box[0])) != 0)) {
+        char detail[128];
+        snprintf(detail, sizeof(detail), "spudec_find_bbox w=%d h=%d stride=%d", w, h, src_stride);
+        ok = fail(name.c_str(), detail);
+      }
+    }
+  }
+  spudec_simd_select(spudec_simd_detect());
+  return ok;
+}
+
+/// Reads a whole file, the file is removed
+string slurp(string const &filename) {
+  string data;
+  {
+    ifstream in(filename.c_str(), ios::binary);
+    data.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+  }
+  remove(filename.c_str());
+  return data;
+}
+
+/**
+ * Writes two streams of random glyph subtitles with the VobSub writer and
+ * reads them back into idx and sub.  The subtitles of the second stream are
+ * split into two more fragments than needed.
+ */
+bool two_streams(string &idx, string &sub) {
+  string const basename = "vobsub2srt-tests-two-streams";
+  remove((basename + ".idx").c_str());
+  remove((basename + ".sub").c_str());
+  unsigned int palette[16] = { 0x108080, 0xeb8080, 0x108080, 0x808080 };
+  char const *const ids[] = { "en", "de" };
+  unsigned const cues[] = { 40, 25 };
+  bool ok = true;
+  for(unsigned stream = 0; stream < 2; ++stream) {
+    void *const vob = vobsub_out_open(basename.c_str(), palette, 720, 576, ids[stream], stream);
+    if(not vob) {
+      return fail("vobsub_out_open", basename);
+    }
+    vector<unsigned char> packet;
+    for(unsigned cue = 0; cue < cues[stream]; ++cue) {
+      spu_bitmap bitmap(400 + 100 * stream, 72);
+      render_glyphs(bitmap, 2, 1000 * stream + cue);
+      encode_spu(bitmap, 60, 480, 2 * 90000, packet);
+      size_t const packs = (packet.size() + 2018) / 2019 + 2 * stream; // 2019 bytes fit into a pack
+      size_t const fragment = (packet.size() + packs - 1) / packs;
+      for(size_t offset = 0; offset < packet.size(); offset += fragment) {
+        size_t const length = packet.size() - offset < fragment ? packet.size() - offset : fragment;
+        vobsub_out_output(vob, &packet[offset], length, 1 + 3 * cue + stream);
+      }
+    }
+    ok = vobsub_out_close(vob) == 0 and ok;
+  }
+  idx = slurp(basename + ".idx");
+  sub = slurp(basename + ".sub");
+  return ok or fail("vobsub_out_close", basename);
+}
+
+/// A stream decoded by vobsub_decode_stream
+struct decoded_stream {
+  decoded_stream() : vob(0x0), stream(-1), subs(0x0), count(-1) { }
+  ~decoded_stream() {
+    spudec_free_subtitles(subs, count > 0 ? count : 0);
+  }
+  void *vob;
+  int stream;
+  spudec_subtitle_t *subs;
+  int count;
+};
+
+void *decode_stream(void *arg) {
+  decoded_stream &d = *static_cast<decoded_stream*>(arg);
+  void *const spu = vobsub_spudec_new(d.vob, 0);
+  d.count = vobsub_decode_stream(d.vob, spu, d.stream, &d.subs);
+  spudec_free(spu);
+  return 0x0;
+}
+
+bool same_subtitles(decoded_stream const &a, decoded_stream const &b) {
+  if(a.count != b.count) {
+    return false;
+  }
+  for(int i = 0; i < a.count; ++i) {
+    spudec_subtitle_t const &x = a.subs[i], &y = b.subs[i];
+    if(x.start_pts != y.start_pts or x.end_pts != y.end_pts or x.x != y.x or x.y != y.y or
+       x.width != y.width or x.height != y.height or x.stride != y.stride or
+       memcmp(x.image, y.image, x.stride * x.height) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Two streams of one handle, each decoded in its own thread with its own
+ * spudec handle, give the same subtitles as decoding them one after the
+ * other.
+ */
+bool parallel_decode() {
+  string idx, sub;
+  if(not two_streams(idx, sub)) {
+    return false;
+  }
+  void *const vob = vobsub_open_memory(idx.data(), idx.size(), reinterpret_cast<unsigned char const*>(sub.data()),
+                                       sub.size(), 0, 0x0);
+  if(not vob or vobsub_get_indexes_count(vob) != 2) {
+    if(vob) {
+      vobsub_close(vob);
+    }
+    return fail("vobsub_open_memory", "expected two streams");
+  }
+
+  unsigned const cues[] = { 40, 25 };
+  decoded_stream sequential[2], parallel[2];
+  for(int i = 0; i < 2; ++i) {
+    sequential[i].vob = parallel[i].vob = vob;
+    sequential[i].stream = parallel[i].stream = vobsub_get_id_by_index(vob, i);
+    decode_stream(&sequential[i]);
+  }
+  pthread_t threads[2];
+  for(int i = 0; i < 2; ++i) {
+    pthread_create(&threads[i], 0x0, decode_stream, &parallel[i]);
+  }
+  for(int i = 0; i < 2; ++i) {
+    pthread_join(threads[i], 0x0);
+  }
+
+  bool ok = true;
+  for(int i = 0; i < 2; ++i) {
+    char detail[64];
+    snprintf(detail, sizeof(detail), "stream %d: %d subtitles", i, sequential[i].count);
+    if(sequential[i].count != int(cues[i])) {
+      ok = fail("sequential decode", detail);
+    }
+    else if(not same_subtitles(sequential[i], parallel[i])) {
+      ok = fail("parallel decode differs", detail);
+    }
+  }
+  vobsub_close(vob);
+  return ok;
+}
+
+/// Writes one cue with writer format and returns the output
+string write_cue(char const *format, string const &text) {
+  FILE *const file = tmpfile();
+  if(not file) {
+    return string();
+  }
+  {
+    output_buffer out(file);
+    subtitle_writer *const writer = create_subtitle_writer(format, out);
+    writer->begin();
+    writer->write(1, 90000, 2 * 90000, text);
+    writer->end();
+    delete writer;
+  }
+  string data;
+  rewind(file);
+  for(int c; (c = getc(file)) != EOF; ) {
+    data += static_cast<char>(c);
+  }
+  fclose(file);
+  return data;
+}
+
+/// OCR text that is markup in the output format is escaped
+bool writer_escaping() {
+  bool ok = true;
+  string const ass = write_cue("ass", "a {b} c\nd");
+  if(ass.find("a \\{b\\} c\\Nd\n") == string::npos) {
+    ok = fail("ass", ass);
+  }
+  string const vtt = write_cue("vtt", "a <b> & c");
+  if(vtt.find("a &lt;b&gt; &amp; c") == string::npos) {
+    ok = fail("vtt", vtt);
+  }
+  return ok;
+}
+
+/// The gray image spudec makes of lines: ink for the text, dark outline, shifted by shift pixels
+struct gray_image {
+  gray_image(vector<string> const &lines, unsigned scale, unsigned shift, unsigned char ink) {
+    spu_bitmap const bitmap = render_text(lines, scale);
+    width = bitmap.width + shift;
+    height = bitmap.height + shift;
+    pixels.assign(width * height, 0);
+    for(unsigned y = 0; y < bitmap.height; ++y) {
+      for(unsigned x = 0; x < bitmap.width; ++x) {
+        unsigned char const index = bitmap.pixels[y * bitmap.width + x];
+        pixels[(y + shift) * width + x + shift] = index == 1 ? ink : index == 2 ? 16 : 0;
+      }
+    }
+  }
+  long find_or_add(image_dedup &dedup, long id) const {
+    return dedup.find_or_add(&pixels[0], width, height, width, id);
+  }
+  unsigned width, height;
+  vector<unsigned char> pixels;
+};
+
+/**
+ * Re-renders of a line (moved, another palette, a few scattered pixels
+ * changed) are merged, lines that differ only in '.' and ',' or ':' and ';'
+ * are not, at small scales and in multi-line images.
+ */
+bool image_dedup_punctuation() {
+  bool ok = true;
+  for(unsigned scale = 1; scale <= 3; ++scale) {
+    for(unsigned two_lines = 0; two_lines < 2; ++two_lines) {
+      char const *const variants[] = { "Wait: now", "Wait; now", "Wait. now", "Wait, now" };
+      image_dedup dedup;
+      long id = 0;
+      for(size_t i = 0; i < sizeof(variants) / sizeof(variants[0]); ++i) {
+        vector<string> lines(1, variants[i]);
+        if(two_lines) {
+          lines.push_back("Come here");
+        }
+        char detail[64];
+        snprintf(detail, sizeof(detail), "'%s' scale %u lines %u", variants[i], scale, static_cast<unsigned>(lines.size()));
+
+        gray_image const original(lines, scale, 0, 255);
+        long const first = id++;
+        if(original.find_or_add(dedup, first) != -1) {
+          ok = fail("merged punctuation", detail);
+        }
+        gray_image const moved(lines, scale, 3, 180);
+        if(moved.find_or_add(dedup, id++) != first) {
+          ok = fail("re-render not merged", detail);
+        }
+        // A few scattered changed pixels.  In smaller images a single
+        // pixel can change the coarse signature, so check the largest scale.
+        if(scale == 3) {
+          gray_image noisy(lines, scale, 0, 255);
+          for(unsigned k = 1; k <= scale; ++k) {
+            unsigned char &pixel = noisy.pixels[(scale * 4) * noisy.width + k * noisy.width / (scale + 1)];
+            pixel = pixel > 127 ? 0 : 255;
+          }
+          if(noisy.find_or_add(dedup, id++) != first) {
+            ok = fail("noisy re-render not merged", detail);
+          }
+        }
+      }
+    }
+  }
+  return ok;
+}
+
+struct test {
+  char const *name;
+  bool (*run)();
+};
+
+test const tests[] = {
+  { "simd_kernels", simd_kernels },
+  { "parallel_decode", parallel_decode },
+  { "writer_escaping", writer_escaping },
+  { "image_dedup_punctuation", image_dedup_punctuation }
+};
+}
+
+int main(int argc, char **argv) {
+  char const *const filter = argc > 1 ? argv[1] : "";
+  int failed = 0;
+  for(size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+    if(strstr(tests[i].name, filter)) {
+      bool const ok = tests[i].run();
+      printf("%-32s %s\n", tests[i].name, ok ? "ok" : "FAILED");
+      failed += not ok;
+    }
+  }
+  return failed ? 1 : 0;
+}
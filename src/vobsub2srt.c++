@@ -23,69 +23,157 @@
 #include "vobsub.h"
 #include "spudec.h"
 
-// Tesseract OCR
-#include "tesseract/baseapi.h"
-
 #include <iostream>
 #include <string>
 #include <cstdio>
+#include <climits>
 #include <vector>
+#include <algorithm>
+#include <fstream>
+#include <unistd.h>
 using namespace std;
 
 #include "langcodes.h++"
 #include "cmd_options.h++"
+#include "line_split.h++"
+#include "ocr.h++"
+#include "image_dedup.h++"
+#include "glyph_cache.h++"
+#include "srt_reader.h++"
+#include "subtitle_writer.h++"
+#include "image_dump.h++"
+#include "ocr_journal.h++"
+#include "stats.h++"
 
 typedef void* vob_t;
 typedef void* spu_t;
 
 // helper struct for caching and fixing end_pts in some cases
 struct sub_text_t {
-  sub_text_t(unsigned start_pts, unsigned end_pts, char const *text)
-    : start_pts(start_pts), end_pts(end_pts), text(text)
+  sub_text_t(unsigned start_pts, unsigned end_pts, size_t first_line, size_t line_count)
+    : start_pts(start_pts), end_pts(end_pts), first_line(first_line), line_count(line_count)
   { }
   unsigned start_pts, end_pts;
-  char const *text;
+  size_t first_line, line_count; ///< lines making up the text (see line_jobs in main)
+  std::string text;
 };
 
-/** Converts time stamp in pts format to a string containing the time stamp for the srt format
- *
- * pts (presentation time stamp) is given with a 90kHz resolution (1/90 ms).
- * srt expects a time stamp as  HH:MM:SS:MSS.
- */
-std::string pts2srt(unsigned pts) {
-  unsigned ms = pts/90;
-  unsigned const h = ms / (3600 * 1000);
-  ms -= h * 3600 * 1000;
-  unsigned const m = ms / (60 * 1000);
-  ms -= m * 60 * 1000;
-  unsigned const s = ms / 1000;
-  ms %= 1000;
-
-  enum { length = sizeof("HH:MM:SS,MSS") };
-  char buf[length];
-  snprintf(buf, length, "%02d:%02d:%02d,%03d", h, m, s, ms);
-  return std::string(buf);
-}
+/// An output file with its buffer and writer
+struct subtitle_output {
+  subtitle_output(std::string const &filename, FILE *file, output_buffer *buffer, subtitle_writer *writer)
+    : filename(filename), file(file), buffer(buffer), writer(writer)
+  { }
+  std::string filename;
+  FILE *file;
+  output_buffer *buffer;
+  subtitle_writer *writer;
+};
 
-/// Dumps the image data to <subtitlename>-<subtitleid>.pgm in Netbpm PGM format
-void dump_pgm(std::string const &filename, unsigned counter, unsigned width, unsigned height,
-              unsigned stride, unsigned char const *image, size_t image_size) {
+/// Waits for the dumped images (--dump-images) and deletes dumper
+void finish_dump(image_dumper *dumper) {
+  if(dumper) {
+    if(not dumper->finish()) {
+      cerr << "WARNING: Failed to dump the images: " << dumper->error() << '\n';
+    }
+    delete dumper;
+  }
+}
 
-  char buf[500];
-  snprintf(buf, sizeof(buf), "%s-%04u.pgm", filename.c_str(), counter);
-  FILE *pgm = fopen(buf, "wb");
-  if(pgm) {
-    fprintf(pgm, "P5\n%u %u %u\n", width, height, 255u);
-    for(unsigned i = 0; i < image_size; i += stride) {
-      fwrite(image + i, 1, width, pgm);
+/// Joins the OCR text of the lines of each subtitle (see sub_text_t)
+void join_lines(std::vector<sub_text_t> &conv_subs, std::vector<ocr_job> const &jobs,
+                std::vector<size_t> const &line_jobs, bool verb) {
+  for(unsigned i = 0; i < conv_subs.size(); ++i) {
+    sub_text_t &conv = conv_subs[i];
+    bool failed = false;
+    for(size_t l = conv.first_line; l < conv.first_line + conv.line_count; ++l) {
+      ocr_job const &job = jobs[line_jobs[l]];
+      if(job.failed) {
+        failed = true;
+      }
+      else if(not job.text.empty()) { // an empty line would end the cue
+        if(not conv.text.empty()) {
+          conv.text += '\n';
+        }
+        conv.text += job.text;
+      }
+    }
+    if(failed) {
+      std::cerr << "ERROR: OCR failed for " << i+1 << '\n';
+      conv.text = "VobSub2SRT ERROR: OCR failure!";
+    }
+    if(verb) {
+      std::cout << i+1 << " Text: " << conv.text << std::endl;
     }
-    fclose(pgm);
   }
 }
 
-#ifdef CONFIG_TESSERACT_NAMESPACE
-using namespace tesseract;
-#endif
+/**
+ * OCRs the jobs with each OCR profile and each batch size (1, 4, 8, 16 and
+ * the --ocr-batch size) and prints the time per subtitle and how well the
+ * text agrees with the reference .srt (cues are matched by their start
+ * time).
+ */
+bool benchmark_profiles(char const *reference_file, ocr_config const &base_conf,
+                        std::vector<std::pair<std::string, std::string> > const &user_vars,
+                        unsigned threads, unsigned batch, std::vector<ocr_job> const &jobs,
+                        std::vector<size_t> const &line_jobs, std::vector<sub_text_t> const &conv_subs) {
+  std::vector<srt_cue> reference;
+  if(not read_srt(reference_file, reference)) {
+    std::cerr << "Failed to read reference '" << reference_file << "'\n";
+    return false;
+  }
+  static char const *const profiles[] = { "fast", "balanced", "accurate" };
+  static unsigned const batch_sizes[] = { 1, 4, 8, 16 };
+  std::vector<unsigned> batches(batch_sizes, batch_sizes + sizeof(batch_sizes) / sizeof(batch_sizes[0]));
+  if(std::find(batches.begin(), batches.end(), batch) == batches.end()) {
+    batches.insert(std::upper_bound(batches.begin(), batches.end(), batch), batch);
+  }
+  printf("%-10s %5s %8s %8s %8s %10s %10s\n", "profile", "batch", "init s", "OCR s", "ms/cue", "identical", "similarity");
+  for(size_t p = 0; p < sizeof(profiles) / sizeof(profiles[0]); ++p) {
+    ocr_engines *engines = 0x0;
+    double init = 0;
+    for(size_t b = 0; b < batches.size(); ++b) {
+      // Batches need the block layout, the engines are started again for the first batch > 1
+      if(b == 0 or (batches[b] > 1 and batches[b - 1] == 1)) {
+        delete engines;
+        ocr_config conf = base_conf;
+        ocr_set_profile(conf, profiles[p]);
+        conf.variables.insert(conf.variables.end(), user_vars.begin(), user_vars.end());
+        if(batches[b] > 1) {
+          conf.layout = ocr_config::layout_block;
+        }
+        double const start = seconds();
+        engines = new ocr_engines;
+        if(not engines->init(conf, threads)) {
+          printf("%-10s %5u failed to initialize\n", profiles[p], batches[b]);
+          break;
+        }
+        init = seconds() - start;
+      }
+      std::vector<ocr_job> results(jobs);
+      double const ocr_start = seconds();
+      engines->run(results, batches[b]);
+      double const ocr_end = seconds();
+
+      std::vector<sub_text_t> texts(conv_subs);
+      join_lines(texts, results, line_jobs, false);
+      size_t identical = 0;
+      double similarity = 0;
+      for(size_t i = 0; i < texts.size(); ++i) {
+        srt_cue const *cue = find_srt_cue(reference, texts[i].start_pts / 90, 500);
+        if(cue) {
+          identical += cue->text == texts[i].text;
+          similarity += text_similarity(cue->text, texts[i].text);
+        }
+      }
+      double const count = texts.empty() ? 1 : texts.size();
+      printf("%-10s %5u %8.2f %8.2f %8.2f %9.1f%% %9.1f%%\n", profiles[p], batches[b], init, ocr_end - ocr_start,
+             (ocr_end - ocr_start) * 1000 / count, 100 * identical / count, 100 * similarity / count);
+    }
+    delete engines;
+  }
+  return true;
+}
 
 #define TESSERACT_DEFAULT_PATH "<builtin default>"
 #ifndef TESSERACT_DATA_PATH
@@ -96,16 +184,39 @@ int main(int argc, char **argv) {
   bool dump_images = false;
   bool verb = false;
   bool list_languages = false;
+  bool forced_only = false;
+  bool no_line_split = false;
+  bool no_dedup = false;
+  bool use_glyph_cache = false;
+  bool binarize = false;
+  bool use_journal = false;
+  bool resume = false;
+  bool show_stats = false;
   std::string ifo_file;
   std::string subname;
   std::string lang;
   std::string tess_lang_user;
   std::string blacklist;
+  std::string ocr_backend_name = "tesseract";
+  std::string ocr_profile = "balanced";
+  std::vector<std::string> tess_vars;
+  std::string benchmark_reference;
+  std::string format = "srt";
+  std::string dump_format = "pgm";
+  std::string output;
+  std::string stats_json;
+  int output_fd = -1;
   std::string tesseract_data_path = TESSERACT_DATA_PATH;
   int index = -1;
   int y_threshold = 0;
   int min_width = 9;
   int min_height = 1;
+  int threads = 0;
+  int tier_threshold = 0;
+  int ocr_batch = 1;
+  int ocr_scale = 1;
+  int ocr_timeout = 0;
+  std::string timeout_fallback = "retry";
 
   {
     /************************************************************************************
@@ -114,23 +225,56 @@ int main(int argc, char **argv) {
     cmd_options opts;
     opts.
       add_option("dump-images", dump_images, "dump subtitles as image files (<subname>-<number>.pgm).").
+      add_option("dump-format", dump_format, "Format of --dump-images: pgm (one file per image) or tar (<subname>-images.tar) (Default: pgm)").
       add_option("verbose", verb, "extra verbosity").
+      add_option("format", format, "Comma separated output formats: srt, vtt, ass, jsonl (Default: srt)").
+      add_option("output", output, "Write the subtitles to this file or to stdout if - (Default: <subname>.<format>)").
+      add_option("output-fd", output_fd, "Write the subtitles to this (open) file descriptor").
       add_option("ifo", ifo_file, "name of the ifo file. default: tries to open <subname>.ifo. ifo file is optional!").
       add_option("lang", lang, "language to select", 'l').
       add_option("langlist", list_languages, "list languages and exit").
       add_option("index", index, "subtitle index", 'i').
       add_option("tesseract-lang", tess_lang_user, "set tesseract language (Default: auto detect)").
       add_option("tesseract-data", tesseract_data_path, "path to tesseract data (Default: " TESSERACT_DATA_PATH ")").
+      add_option("ocr-backend", ocr_backend_name, "OCR backend: tesseract or null (no OCR, for benchmarks) (Default: tesseract)").
+      add_option("ocr-profile", ocr_profile, "OCR speed/accuracy tradeoff: fast, balanced or accurate (Default: balanced)").
+      add_option("tess-var", tess_vars, "Set a tesseract variable (key=value), e.g. tessedit_pageseg_mode=13").
+      add_option("benchmark-profiles", benchmark_reference, "OCR with each profile and compare the text with a reference .srt instead of writing the .srt").
+      add_option("ocr-scale", ocr_scale, "Upscale the images by this factor (1-8) before the OCR (Default: 1)").
+      add_option("binarize", binarize, "Binarize the images before the OCR").
+      add_option("ocr-timeout", ocr_timeout, "Cancel the OCR of an image after this many milliseconds (Default: 0 = no limit)").
+      add_option("timeout-fallback", timeout_fallback, "After an OCR timeout: retry with a simpler page layout or fail (Default: retry)").
       add_option("blacklist", blacklist, "Character blacklist to improve the OCR (e.g. \"|\\/`_~<>\")").
       add_option("y-threshold", y_threshold, "Y (luminance) threshold below which colors treated as black (Default: 0)").
       add_option("min-width", min_width, "Minimum width in pixels to consider a subpicture for OCR (Default: 9)").
       add_option("min-height", min_height, "Minimum height in pixels to consider a subpicture for OCR (Default: 1)").
+      add_option("forced-only", forced_only, "only convert forced subtitles").
+      add_option("tier-threshold", tier_threshold, "OCR with the fast engine first and re-run lines with a lower confidence (0-100) with the accurate engine (Default: 0 = off)").
+      add_option("ocr-batch", ocr_batch, "Number of images stacked into one page for the OCR (Default: 1)").
+      add_option("no-line-split", no_line_split, "OCR the whole subtitle image at once instead of line by line").
+      add_option("no-dedup", no_dedup, "OCR every image, even if it looks the same as an earlier one").
+      add_option("glyph-cache", use_glyph_cache, "Learn the glyphs of the font from the OCR and only OCR lines with unknown glyphs").
+      add_option("journal", use_journal, "Record the OCR results in <subname>.journal as they are recognized").
+      add_option("resume", resume, "Continue a conversion from <subname>.journal and only OCR the remaining images").
+      add_option("stats", show_stats, "Print the time of each stage, counters and the OCR latency of the cues at exit").
+      add_option("stats-json", stats_json, "Write the --stats summary as JSON to this file").
+      add_option("threads", threads, "Number of threads used to decode and OCR the subtitle images (Default: 0 = one per CPU)").
       add_unnamed(subname, "subname", "name of the subtitle files WITHOUT .idx/.sub ending! (REQUIRED)");
     if(not opts.parse_cmd(argc, argv) or subname.empty()) {
       return 1;
     }
   }
 
+  if(not output.empty() and output_fd >= 0) {
+    cerr << "Use either --output or --output-fd.\n";
+    return 1;
+  }
+  // Keep stdout clean for the subtitles: all messages go to stderr
+  if(output == "-" or output_fd == STDOUT_FILENO) {
+    cout.rdbuf(cerr.rdbuf());
+    mp_msg_stderr = 1;
+  }
+
   // Init the mplayer part
   verbose = verb; // mplayer verbose level
   mp_msg_init();
@@ -141,8 +285,11 @@ int main(int argc, char **argv) {
   }
 
   // Open the sub/idx subtitles
+  run_stats stats;
+  stats.begin(run_stats::stage_open);
   spu_t spu;
   vob_t vob = vobsub_open(subname.c_str(), ifo_file.empty() ? 0x0 : ifo_file.c_str(), 1, y_threshold, &spu);
+  stats.end(run_stats::stage_open);
   if(not vob or vobsub_get_indexes_count(vob) == 0) {
     cerr << "Couldn't open VobSub files '" << subname << ".idx/.sub'\n";
     return 1;
@@ -186,11 +333,11 @@ int main(int argc, char **argv) {
              << vobsub_get_indexes_count(vob) << ")\n";
         return 1;
       }
-      vobsub_id = index;
+      vobsub_set_stream(vob, index);
     }
 
-    if(vobsub_id >= 0) { // try to set correct tesseract lang for default stream
-      char const *const lang1 = vobsub_get_id(vob, vobsub_id);
+    if(vobsub_get_stream(vob) >= 0) { // try to set correct tesseract lang for default stream
+      char const *const lang1 = vobsub_get_id(vob, vobsub_get_stream(vob));
       if(lang1 and tess_lang_user.empty()) {
         char const *const lang3 = iso639_1_to_639_3(lang1);
         if(lang3) {
@@ -200,121 +347,472 @@ int main(int argc, char **argv) {
     }
   }
 
+  if(threads <= 0) {
+    long const cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? cpus : 1;
+  }
+
   // Init Tesseract
-  char const *tess_path = NULL;
+  ocr_config ocr_conf;
+  ocr_conf.backend = ocr_backend_name;
   if (tesseract_data_path != TESSERACT_DEFAULT_PATH)
-    tess_path = tesseract_data_path.c_str();
-
-#ifdef CONFIG_TESSERACT_NAMESPACE
-  TessBaseAPI tess_base_api;
-  if(tess_base_api.Init(tess_path, tess_lang) == -1) {
-    cerr << "Failed to initialize tesseract (OCR).\n";
+    ocr_conf.data_path = tesseract_data_path.c_str();
+  ocr_conf.lang = tess_lang;
+  ocr_conf.blacklist = blacklist;
+  ocr_conf.layout = no_line_split ? ocr_config::layout_auto : ocr_config::layout_line;
+  if(use_glyph_cache and no_line_split) {
+    cerr << "WARNING: The glyph cache needs line splitting. Glyph cache disabled.\n";
+  }
+  ocr_conf.glyph_cache = use_glyph_cache and not no_line_split;
+  if(ocr_scale < 1 or ocr_scale > 8) {
+    cerr << "Invalid OCR scale " << ocr_scale << ". Use 1 to 8.\n";
     return 1;
   }
-  if(not blacklist.empty()) {
-    tess_base_api.SetVariable("tessedit_char_blacklist", blacklist.c_str());
+  ocr_conf.scale = ocr_scale;
+  if(timeout_fallback != "retry" and timeout_fallback != "fail") {
+    cerr << "Unknown timeout fallback '" << timeout_fallback << "'. Use retry or fail.\n";
+    return 1;
   }
-#else
-  TessBaseAPI::SimpleInit(tess_path, tess_lang, false); // TODO params
-  if(not blacklist.empty()) {
-    TessBaseAPI::SetVariable("tessedit_char_blacklist", blacklist.c_str());
+  if(dump_format != "pgm" and dump_format != "tar") {
+    cerr << "Unknown dump format '" << dump_format << "'. Use pgm or tar.\n";
+    return 1;
+  }
+  ocr_conf.timeout_ms = ocr_timeout > 0 ? ocr_timeout : 0;
+  ocr_conf.binarize = binarize;
+  vector<pair<string, string> > user_vars;
+  for(size_t i = 0; i < tess_vars.size(); ++i) {
+    size_t const eq = tess_vars[i].find('=');
+    if(eq == 0 or eq == string::npos) {
+      cerr << "Invalid tesseract variable '" << tess_vars[i] << "', expected key=value\n";
+      return 1;
+    }
+    user_vars.push_back(make_pair(tess_vars[i].substr(0, eq), tess_vars[i].substr(eq + 1)));
+  }
+  ocr_config const base_conf = ocr_conf; // without a profile for --benchmark-profiles
+  if(not ocr_set_profile(ocr_conf, ocr_profile)) {
+    cerr << "Unknown OCR profile '" << ocr_profile << "'. Use fast, balanced or accurate.\n";
+    return 1;
+  }
+  ocr_conf.variables.insert(ocr_conf.variables.end(), user_vars.begin(), user_vars.end());
+  ocr_config accurate_conf = ocr_conf;
+  accurate_conf.glyph_cache = false;
+  if(ocr_batch > 1) {
+    ocr_conf.layout = ocr_config::layout_block;
+  }
+  bool const benchmark = not benchmark_reference.empty();
+  ocr_engines ocr;
+  if(tier_threshold > 0 and not benchmark) {
+    ocr_conf.engine = ocr_config::engine_fast;
+    if(not ocr.init(ocr_conf, threads) or not ocr.concurrent()) {
+      cerr << "WARNING: No fast OCR engine available. Tiered OCR disabled.\n";
+      tier_threshold = 0;
+      ocr_conf.engine = accurate_conf.engine;
+    }
+  }
+  if(not benchmark and ocr.size() == 0 and not ocr.init(ocr_conf, threads)) {
+    if(ocr_backend_name == "tesseract") {
+      cerr << "Failed to initialize tesseract (OCR).\n";
+    }
+    else {
+      cerr << "Failed to initialize OCR backend '" << ocr_backend_name << "'.\n";
+    }
+    return 1;
+  }
+
+  // Output formats
+  vector<string> formats;
+  for(size_t start = 0; start <= format.size();) {
+    size_t end = format.find(',', start);
+    if(end == string::npos) {
+      end = format.size();
+    }
+    string const name = format.substr(start, end - start);
+    if(not subtitle_format_known(name)) {
+      cerr << "Unknown output format '" << name << "'. Use srt, vtt, ass or jsonl.\n";
+      return 1;
+    }
+    if(find(formats.begin(), formats.end(), name) == formats.end()) {
+      formats.push_back(name);
+    }
+    start = end + 1;
+  }
+  if((not output.empty() or output_fd >= 0) and formats.size() > 1) {
+    cerr << "--output and --output-fd need a single --format.\n";
+    return 1;
+  }
+  // Journal of the OCR results (<subname>.journal) to resume a conversion that was killed
+  ocr_journal journal;
+  bool const journaling = (use_journal or resume) and not benchmark;
+  string const journal_file = subname + ".journal";
+  if(journaling) {
+    if(resume and not journal.load(journal_file)) {
+      perror(("could not read " + journal_file).c_str());
+      return 1;
+    }
+    if(not journal.open(journal_file, resume)) {
+      perror(("could not open " + journal_file).c_str());
+      return 1;
+    }
   }
-#endif
 
-  // Open srt output file
-  string const srt_filename = subname + ".srt";
-  FILE *srtout = fopen(srt_filename.c_str(), "w");
-  if(not srtout) {
-    perror("could not open .srt file");
+  // Decode all subtitles of the stream
+  int const stream = vobsub_get_stream(vob);
+  spudec_set_threads(spu, threads);
+  // always set: "forced subs: ON" in the .idx should not hide subtitles
+  spudec_set_forced_subs_only(spu, forced_only);
+  spudec_subtitle_t *subs = 0x0;
+  stats.begin(run_stats::stage_decode);
+  int const subs_count = vobsub_decode_stream(vob, spu, stream, &subs);
+  stats.end(run_stats::stage_decode);
+  if(subs_count < 0) {
+    cerr << "Failed to decode subtitles.\n";
     return 1;
   }
 
-  // Read subtitles and convert
-  void *packet;
-  int timestamp; // pts100
-  int len;
-  unsigned last_start_pts = 0;
+  // Images are written in the background.  Only now: a failure above keeps
+  // the old images (--dump-format tar truncates the archive).
+  image_dumper *dumper = dump_images
+    ? new image_dumper(subname, dump_format == "tar" ? image_dumper::tar_archive : image_dumper::pgm_files)
+    : 0x0;
+
+  // Split the images into lines
+  stats.begin(run_stats::stage_split);
   unsigned sub_counter = 1;
   vector<sub_text_t> conv_subs;
-  conv_subs.reserve(200); // TODO better estimate
-  while( (len = vobsub_get_next_packet(vob, &packet, &timestamp)) > 0) {
-    if(timestamp >= 0) {
-      spudec_assemble(spu, reinterpret_cast<unsigned char*>(packet), len, timestamp);
-      spudec_heartbeat(spu, timestamp);
-      unsigned char const *image;
-      size_t image_size;
-      unsigned width, height, stride, start_pts, end_pts;
-      spudec_get_data(spu, &image, &image_size, &width, &height, &stride, &start_pts, &end_pts);
-
-      // skip this packet if it is another packet of a subtitle that
-      // was decoded from multiple mpeg packets.
-      if (start_pts == last_start_pts) {
-        continue;
-      }
-      last_start_pts = start_pts;
+  conv_subs.reserve(subs_count);
+  vector<ocr_job> jobs;
+  vector<size_t> line_jobs; // OCR job for each line, near-duplicate lines share one
+  vector<journal_key> job_keys; // only with the journal
+  image_dedup dedup;
+  vector<text_line> lines;
+  for(int i = 0; i < subs_count; ++i) {
+    spudec_subtitle_t const &sub = subs[i];
+    unsigned const width = sub.width, height = sub.height, stride = sub.stride;
+    size_t const image_size = stride * height;
+    unsigned char const *const image = sub.image;
+
+    if(width < (unsigned int)min_width || height < (unsigned int)min_height) {
+      cerr << "WARNING: Image too small " << sub_counter << ", size: " << image_size << " bytes, "
+           << width << "x" << height << " pixels, expected at least " << min_width << "x" << min_height << "\n";
+      ++stats.too_small;
+      continue;
+    }
 
-      if(width < (unsigned int)min_width || height < (unsigned int)min_height) {
-        cerr << "WARNING: Image too small " << sub_counter << ", size: " << image_size << " bytes, "
-             << width << "x" << height << " pixels, expected at least " << min_width << "x" << min_height << "\n";
-        continue;
-      }
+    if(verbose > 0 and static_cast<unsigned>(sub.packet_pts) != sub.start_pts) {
+      cerr << sub_counter << ": time stamp from .idx (" << sub.packet_pts
+           << ") doesn't match time stamp from .sub ("
+           << sub.start_pts << ")\n";
+    }
 
-      if(verbose > 0 and static_cast<unsigned>(timestamp) != start_pts) {
-        cerr << sub_counter << ": time stamp from .idx (" << timestamp
-             << ") doesn't match time stamp from .sub ("
-             << start_pts << ")\n";
-      }
+    if(dumper) {
+      dumper->dump(sub_counter, image, width, height, stride);
+    }
 
-      if(dump_images) {
-        dump_pgm(subname, sub_counter, width, height, stride, image, image_size);
+    lines.clear();
+    if(not no_line_split) {
+      split_lines(image, width, height, stride, lines);
+    }
+    if(lines.empty()) { // no lines found (e.g. dark text) or no splitting
+      lines.push_back(text_line(0, height));
+    }
+    size_t const first_line = line_jobs.size();
+    for(size_t l = 0; l < lines.size(); ++l) {
+      ocr_job const job(image + lines[l].y * stride, width, lines[l].height, stride);
+      long const same = no_dedup ? -1 : dedup.find_or_add(job.image, job.width, job.height, job.stride, jobs.size());
+      if(same < 0) {
+        line_jobs.push_back(jobs.size());
+        jobs.push_back(job);
+        if(journaling) {
+          job_keys.push_back(journal_key(stream, sub.start_pts, image_hash(job.image, job.width, job.height, job.stride)));
+        }
       }
+      else {
+        line_jobs.push_back(same);
+      }
+    }
+    conv_subs.push_back(sub_text_t(sub.start_pts, sub.end_pts, first_line, lines.size()));
+    ++sub_counter;
+  }
+  stats.end(run_stats::stage_split);
+
+  if(benchmark) {
+    bool const ok = benchmark_profiles(benchmark_reference.c_str(), base_conf, user_vars, threads,
+                                       ocr_batch > 1 ? ocr_batch : 1, jobs, line_jobs, conv_subs);
+    finish_dump(dumper);
+    spudec_free_subtitles(subs, subs_count);
+    vobsub_close(vob);
+    spudec_free(spu);
+    return ok ? 0 : 1;
+  }
 
-#ifdef CONFIG_TESSERACT_NAMESPACE
-      char *text = tess_base_api.TesseractRect(image, 1, stride, 0, 0, width, height);
-#else
-      char *text = TessBaseAPI::TesseractRect(image, 1, stride, 0, 0, width, height);
-#endif
-      if(not text) {
-        cerr << "ERROR: OCR failed for " << sub_counter << '\n';
-        char const errormsg[] = "VobSub2SRT ERROR: OCR failure!";
-        // using raw memory is evil but that's the way Tesseract works
-        // If we switch to C++11 we can use unique_ptr.
-        text = new char[sizeof(errormsg)];
-        memcpy(text, errormsg, sizeof(errormsg));
+  // Open the output files (<subname>.<format> or --output/--output-fd).  Only
+  // now: a failure above (e.g. a bad journal for --resume) keeps the old files.
+  vector<subtitle_output> outputs;
+  for(size_t i = 0; i < formats.size(); ++i) {
+    string filename = output.empty() ? subname + "." + formats[i] : output;
+    FILE *file;
+    if(output_fd >= 0) {
+      char name[sizeof("<fd -2147483648>")];
+      snprintf(name, sizeof(name), "<fd %d>", output_fd);
+      filename = name;
+      file = output_fd == STDOUT_FILENO ? stdout : fdopen(output_fd, "w");
+    }
+    else if(output == "-") {
+      filename = "<stdout>";
+      file = stdout;
+    }
+    else {
+      file = fopen(filename.c_str(), "w");
+    }
+    if(not file) {
+      perror(("could not open " + filename).c_str());
+      finish_dump(dumper);
+      return 1;
+    }
+    output_buffer *buffer = new output_buffer(file);
+    outputs.push_back(subtitle_output(filename, file, buffer, create_subtitle_writer(formats[i], *buffer)));
+  }
+
+  // With --resume take the results from the journal
+  stats.begin(run_stats::stage_ocr);
+  vector<size_t> todo;
+  vector<bool> tiered(jobs.size()); // already re-run with the accurate engine
+  for(size_t i = 0; i < jobs.size(); ++i) {
+    ocr_journal::entry const *const entry = resume ? journal.find(job_keys[i]) : 0x0;
+    if(entry and (not entry->failed or entry->timed_out)) { // other failures are tried again
+      jobs[i].text = entry->text;
+      jobs[i].confidence = entry->confidence;
+      jobs[i].failed = entry->failed;
+      jobs[i].timed_out = entry->timed_out;
+      tiered[i] = entry->pass == ocr_journal::pass_tier;
+    }
+    else {
+      todo.push_back(i);
+    }
+  }
+  if(resume) {
+    cout << "Resumed " << jobs.size() - todo.size() << " of " << jobs.size() << " images from '"
+         << journal_file << "'\n";
+  }
+
+  // OCR all (remaining) lines, using all engines in parallel
+  unsigned const batch = ocr_batch > 1 ? ocr_batch : 1;
+  size_t ocr_calls;
+  if(todo.size() == jobs.size()) {
+    journal_observer observer(journal, ocr_journal::pass_ocr, job_keys);
+    ocr_calls = ocr.run(jobs, batch, journaling ? &observer : 0x0);
+  }
+  else {
+    vector<ocr_job> remaining;
+    vector<journal_key> remaining_keys;
+    remaining.reserve(todo.size());
+    remaining_keys.reserve(todo.size());
+    for(size_t i = 0; i < todo.size(); ++i) {
+      remaining.push_back(jobs[todo[i]]);
+      remaining_keys.push_back(job_keys[todo[i]]);
+    }
+    journal_observer observer(journal, ocr_journal::pass_ocr, remaining_keys);
+    ocr_calls = ocr.run(remaining, batch, &observer);
+    for(size_t i = 0; i < todo.size(); ++i) {
+      jobs[todo[i]] = remaining[i];
+    }
+  }
+  if(verb) {
+    cout << "OCR: " << todo.size() << " images in " << ocr_calls << " calls\n";
+    if(not no_dedup) {
+      cout << "Reused OCR text for " << line_jobs.size() - jobs.size() << " of " << line_jobs.size()
+           << " images (" << dedup.rejected() << " of " << dedup.candidates() << " similar images differed)\n";
+    }
+    if(ocr.glyphs()) {
+      glyph_cache const &glyphs = *ocr.glyphs();
+      cout << "Glyph cache: " << glyphs.hits() << " of " << glyphs.hits() + glyphs.misses()
+           << " lines recognized from " << glyphs.glyphs() << " learned glyphs\n";
+    }
+  }
+
+  // Images cancelled after --ocr-timeout: retry with a simpler page layout or give up
+  vector<size_t> timed_out;
+  ocr_select_timed_out(jobs, timed_out);
+  if(not timed_out.empty()) {
+    size_t recovered = 0;
+    if(timeout_fallback == "retry") {
+      ocr_config retry_conf = ocr_conf;
+      retry_conf.layout = no_line_split ? ocr_config::layout_block : ocr_config::layout_raw_line;
+      retry_conf.glyph_cache = false;
+      vector<ocr_job> retry;
+      retry.reserve(timed_out.size());
+      for(size_t i = 0; i < timed_out.size(); ++i) {
+        ocr_job const &job = jobs[timed_out[i]];
+        retry.push_back(ocr_job(job.image, job.width, job.height, job.stride));
+      }
+      ocr_engines simple;
+      if(simple.init(retry_conf, threads)) {
+        stats.ocr_calls += simple.run(retry);
+        for(size_t i = 0; i < timed_out.size(); ++i) {
+          retry[i].seconds += jobs[timed_out[i]].seconds;
+          jobs[timed_out[i]].seconds = retry[i].seconds;
+          if(not retry[i].failed) {
+            jobs[timed_out[i]] = retry[i];
+            ++recovered;
+            if(journaling) {
+              journal.record(job_keys[timed_out[i]], ocr_journal::pass_retry, jobs[timed_out[i]]);
+            }
+          }
+        }
       }
       else {
-          size_t size = strlen(text);
-          while (size > 0 and isspace(text[--size])) {
-              text[size] = '\0';
+        cerr << "WARNING: Failed to initialize the OCR engine for timeouts.\n";
+      }
+    }
+    vector<bool> cut_off(jobs.size());
+    for(size_t i = 0; i < timed_out.size(); ++i) {
+      cut_off[timed_out[i]] = true;
+    }
+    cerr << "WARNING: OCR timed out after " << ocr_timeout << " ms for " << timed_out.size() << " images, cues:";
+    for(size_t i = 0; i < conv_subs.size(); ++i) {
+      for(size_t l = conv_subs[i].first_line; l < conv_subs[i].first_line + conv_subs[i].line_count; ++l) {
+        if(cut_off[line_jobs[l]]) {
+          cerr << ' ' << i+1;
+          stats.timed_out_cues.push_back(i+1);
+          break;
+        }
+      }
+    }
+    cerr << " (" << recovered << " images recovered with a simpler page layout)\n";
+    stats.timed_out = timed_out.size();
+    stats.timeout_recovered = recovered;
+  }
+
+  // Tiered OCR: re-run the lines of uncertain cues with the accurate engine
+  if(tier_threshold > 0) {
+    vector<vector<size_t> > cue_jobs(conv_subs.size());
+    for(size_t i = 0; i < conv_subs.size(); ++i) {
+      for(size_t l = conv_subs[i].first_line; l < conv_subs[i].first_line + conv_subs[i].line_count; ++l) {
+        cue_jobs[i].push_back(line_jobs[l]);
+      }
+    }
+    vector<size_t> low;
+    ocr_select_low_confidence(jobs, cue_jobs, tier_threshold, low);
+    size_t kept = 0;
+    for(size_t i = 0; i < low.size(); ++i) {
+      if(not tiered[low[i]]) {
+        low[kept++] = low[i];
+      }
+    }
+    low.resize(kept);
+    size_t const resumed = count(tiered.begin(), tiered.end(), true);
+    if(not low.empty()) {
+      vector<ocr_job> retry;
+      retry.reserve(low.size());
+      for(size_t i = 0; i < low.size(); ++i) {
+        ocr_job const &job = jobs[low[i]];
+        retry.push_back(ocr_job(job.image, job.width, job.height, job.stride));
+      }
+      ocr_engines accurate;
+      if(accurate.init(accurate_conf, threads)) {
+        stats.ocr_calls += accurate.run(retry);
+        for(size_t i = 0; i < low.size(); ++i) {
+          retry[i].seconds += jobs[low[i]].seconds;
+          jobs[low[i]].seconds = retry[i].seconds;
+          if(not retry[i].failed) {
+            jobs[low[i]] = retry[i];
+            if(journaling) {
+              journal.record(job_keys[low[i]], ocr_journal::pass_tier, jobs[low[i]]);
+            }
           }
+        }
       }
-      if(verb) {
-        cout << sub_counter << " Text: " << text << endl;
+      else {
+        cerr << "WARNING: Failed to initialize the accurate OCR engine.\n";
       }
-      conv_subs.push_back(sub_text_t(start_pts, end_pts, text));
-      ++sub_counter;
     }
+    cout << "Tiered OCR: " << jobs.size() - low.size() - resumed << " of " << jobs.size()
+         << " lines from the fast engine, " << low.size() + resumed
+         << " re-run with the accurate engine (confidence below " << tier_threshold << ")\n";
+  }
+  stats.end(run_stats::stage_ocr);
+  stats.ocr_calls += ocr_calls;
+  stats.images = todo.size();
+  stats.resumed = jobs.size() - todo.size();
+  for(size_t i = 0; i < jobs.size(); ++i) {
+    stats.ocr_failures += jobs[i].failed;
   }
 
-  // write the file, fixing end_pts when needed
+  join_lines(conv_subs, jobs, line_jobs, verb);
+  finish_dump(dumper);
+  spudec_free_subtitles(subs, subs_count);
+
+  // write the files, fixing end_pts when needed
+  stats.begin(run_stats::stage_write);
+  for(size_t o = 0; o < outputs.size(); ++o) {
+    outputs[o].writer->begin();
+  }
   for(unsigned i = 0; i < conv_subs.size(); ++i) {
     if(conv_subs[i].end_pts == UINT_MAX && i+1 < conv_subs.size())
       conv_subs[i].end_pts = conv_subs[i+1].start_pts;
 
-    fprintf(srtout, "%u\n%s --> %s\n%s\n\n", i+1, pts2srt(conv_subs[i].start_pts).c_str(),
-            pts2srt(conv_subs[i].end_pts).c_str(), conv_subs[i].text);
+    for(size_t o = 0; o < outputs.size(); ++o) {
+      outputs[o].writer->write(i+1, conv_subs[i].start_pts, conv_subs[i].end_pts, conv_subs[i].text);
+    }
+  }
 
-    delete[]conv_subs[i].text;
-    conv_subs[i].text = 0x0;
+  int ret = 0;
+  for(size_t o = 0; o < outputs.size(); ++o) {
+    outputs[o].writer->end();
+    delete outputs[o].writer;
+    bool const flushed = outputs[o].buffer->flush();
+    delete outputs[o].buffer;
+    bool const closed = (outputs[o].file == stdout ? fflush(stdout) : fclose(outputs[o].file)) == 0;
+    if(not flushed or not closed) {
+      cerr << "Failed to write '" << outputs[o].filename << "'\n";
+      ret = 1;
+    }
+    else {
+      cout << "Wrote Subtitles to '" << outputs[o].filename << "'\n";
+    }
+  }
+  stats.end(run_stats::stage_write);
+  if(journaling and not journal.close()) {
+    cerr << "WARNING: Failed to write the journal '" << journal_file << "'\n";
+  }
+  if(verb) {
+    spudec_pool_stats_t pool;
+    spudec_get_pool_stats(spu, &pool);
+    cout << "Buffer pool: " << pool.requests << " requests, " << pool.reused << " reused, "
+         << pool.allocated << " allocated, " << pool.dropped << " dropped\n";
   }
 
-#ifdef CONFIG_TESSERACT_NAMESPACE
-  tess_base_api.End();
-#else
-  TessBaseAPI::End();
-#endif
-  fclose(srtout);
-  cout << "Wrote Subtitles to '" << srt_filename << "'\n";
+  if(show_stats or not stats_json.empty()) {
+    vobsub_get_stats(vob, &stats.demux);
+    spudec_get_decode_stats(spu, &stats.decode);
+    stats.cues = conv_subs.size();
+    stats.lines = line_jobs.size();
+    // the OCR time of a cue: its lines, without those reusing the text of an earlier line
+    vector<bool> counted(jobs.size());
+    stats.cue_seconds.reserve(conv_subs.size());
+    for(size_t i = 0; i < conv_subs.size(); ++i) {
+      double cue_seconds = 0;
+      for(size_t l = conv_subs[i].first_line; l < conv_subs[i].first_line + conv_subs[i].line_count; ++l) {
+        if(not counted[line_jobs[l]]) {
+          counted[line_jobs[l]] = true;
+          cue_seconds += jobs[line_jobs[l]].seconds;
+        }
+      }
+      stats.cue_seconds.push_back(cue_seconds);
+    }
+    if(show_stats) {
+      stats.print(cerr);
+    }
+    if(not stats_json.empty()) {
+      std::ofstream json(stats_json.c_str());
+      stats.print_json(json);
+      if(not json.flush()) {
+        cerr << "Failed to write '" << stats_json << "'\n";
+        ret = 1;
+      }
+    }
+  }
   vobsub_close(vob);
   spudec_free(spu);
+  return ret;
 }